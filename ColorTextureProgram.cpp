@@ -2,8 +2,9 @@
 
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
+#include "gl_state.hpp"
 
-Load< ColorTextureProgram > color_texture_program(LoadTagEarly);
+Load< ColorTextureProgram > color_texture_program(LoadOptions{"color texture program", LoadOnGLThread, {}, LoadOnFirstUse});
 
 ColorTextureProgram::ColorTextureProgram() {
 	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
@@ -45,11 +46,11 @@ ColorTextureProgram::ColorTextureProgram() {
 	GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
 
 	//set TEX to always refer to texture binding zero:
-	glUseProgram(program); //bind program -- glUniform* calls refer to this program now
+	gl_state.use_program(program); //bind program -- glUniform* calls refer to this program now
 
 	glUniform1i(TEX_sampler2D, 0); //set TEX to sample from GL_TEXTURE0
 
-	glUseProgram(0); //unbind program -- glUniform* calls refer to ??? now
+	gl_state.use_program(0); //unbind program -- glUniform* calls refer to ??? now
 }
 
 ColorTextureProgram::~ColorTextureProgram() {
@@ -0,0 +1,122 @@
+#include "DataFile.hpp"
+#include "Load.hpp"
+#include "read_write_chunk.hpp"
+
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+//mounted packs, and where each packed file lives in them:
+// (only changed by mount_data_pack, before loading starts, so loader threads can read without locking)
+static std::deque< MappedFile > &mounted_packs() {
+	static std::deque< MappedFile > packs;
+	return packs;
+}
+
+struct PackedFile {
+	char const *begin;
+	size_t length;
+};
+
+static std::unordered_map< std::string, PackedFile > &packed_files() {
+	static std::unordered_map< std::string, PackedFile > files;
+	return files;
+}
+
+DataFile::DataFile(std::string const &filename_) : filename(filename_) {
+	auto const &files = packed_files();
+	auto f = files.find(filename);
+	if (f != files.end()) {
+		begin = f->second.begin;
+		length = f->second.length;
+		count_load_read(length); //(charged like a MappedFile, though only touched pages are read)
+	} else {
+		file.reset(new MappedFile(filename));
+		begin = file->data();
+		length = file->size();
+	}
+}
+
+DataStream::Buffer::Buffer(char const *begin, size_t size) {
+	char *b = const_cast< char * >(begin); //(streambuf wants char *, but input-only buffers are never written)
+	setg(b, b, b + size);
+}
+
+DataStream::Buffer::pos_type DataStream::Buffer::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+	if (which & std::ios_base::out) return pos_type(off_type(-1));
+	off_type base = 0;
+	if (dir == std::ios_base::cur) base = gptr() - eback();
+	else if (dir == std::ios_base::end) base = egptr() - eback();
+	off_type pos = base + off;
+	if (pos < 0 || pos > egptr() - eback()) return pos_type(off_type(-1));
+	setg(eback(), eback() + pos, egptr());
+	return pos_type(pos);
+}
+
+DataStream::Buffer::pos_type DataStream::Buffer::seekpos(pos_type pos, std::ios_base::openmode which) {
+	return seekoff(off_type(pos), std::ios_base::beg, which);
+}
+
+DataStream::DataStream(std::string const &filename) : std::istream(nullptr), file(filename), buffer(file.data(), file.size()) {
+	rdbuf(&buffer);
+}
+
+void mount_data_pack(std::string const &pack_filename) {
+	MappedFile &pack = mounted_packs().emplace_back(pack_filename);
+	pack.prefetch();
+
+	ChunkReader reader(pack.data(), pack.data() + pack.size());
+	ChunkView< char > names = reader.find< char >("str0");
+	ChunkView< DataPackEntry > entries = reader.find< DataPackEntry >("pak0");
+	//(file views point straight into the mapping, so the data can't be stored compressed)
+	ChunkTocEntry const *data_entry = reader.lookup("dat0");
+	if (data_entry && data_entry->encoding != ChunkTocEntry::Raw) {
+		throw std::runtime_error("Pack '" + pack_filename + "' has compressed file data.");
+	}
+	ChunkView< char > data = reader.find< char >("dat0");
+
+	//names in the pack are relative to the pack's directory:
+	std::string directory = pack_filename.substr(0, pack_filename.find_last_of("/\\") + 1);
+
+	//packed files whose loose copy has been changed since the pack was built are read from disk instead:
+	// (so a stale pack never hides an edit; pack-assets should be re-run before shipping)
+	std::error_code ec;
+	auto pack_time = std::filesystem::last_write_time(pack_filename, ec);
+	bool check_times = !ec;
+	std::vector< std::string > newer;
+
+	//check every entry before mounting any, so a malformed pack mounts nothing:
+	std::vector< std::pair< std::string, PackedFile > > found;
+	found.reserve(entries.size());
+	for (auto const &entry : entries) {
+		if (!(entry.name_begin <= entry.name_end && entry.name_end <= names.size())) {
+			throw std::runtime_error("Pack '" + pack_filename + "' has an entry with out-of-range name.");
+		}
+		std::string name(names.data() + entry.name_begin, names.data() + entry.name_end);
+		if (!(entry.data_begin <= entry.data_end && entry.data_end <= data.size())) {
+			throw std::runtime_error("Pack '" + pack_filename + "' has out-of-range data for '" + name + "'.");
+		}
+		if (check_times) {
+			auto loose_time = std::filesystem::last_write_time(directory + name, ec);
+			if (!ec && loose_time > pack_time) {
+				newer.emplace_back(name);
+				continue;
+			}
+		}
+		found.emplace_back(directory + name, PackedFile{ data.data() + entry.data_begin, size_t(entry.data_end - entry.data_begin) });
+	}
+	if (!newer.empty()) {
+		std::cerr << "WARNING: " << newer.size() << " file(s) changed since '" << pack_filename << "' was built; reading them from disk instead:";
+		for (auto const &name : newer) std::cerr << " '" << name << "'";
+		std::cerr << std::endl;
+	}
+
+	//(a later pack overrides files from an earlier one)
+	auto &files = packed_files();
+	for (auto &f : found) {
+		files[f.first] = f.second;
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+/*
+ * A DataFile is a read-only view of the bytes of a data file (as named by data_path):
+ *  if a mounted pack holds the file, the view points into the pack's mapping;
+ *  otherwise the file itself is mapped (see MappedFile.hpp).
+ *
+ * Packs are written by pack-assets (see pack-assets.cpp), which bundles files into one chunk file:
+ *  "str0" -- file names, relative to the pack's directory ('/'-separated)
+ *  "pak0" -- name range and data range for each file (DataPackEntry), sorted by name
+ *  "dat0" -- file contents, each starting on a ChunkWriter::ChunkAlignment boundary
+ * so chunk files stored in a pack keep the alignment that ChunkReader views rely on.
+ *
+ * Loaders that want a stream rather than a view can use a DataStream;
+ *  loaders for libraries that open files themselves should hand them data() and size() instead.
+ */
+
+#include "MappedFile.hpp"
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+struct DataFile {
+	//view 'filename':
+	// note: will throw if no mounted pack holds the file and it can't be mapped.
+	DataFile(std::string const &filename);
+
+	DataFile(DataFile const &) = delete;
+	DataFile &operator=(DataFile const &) = delete;
+
+	char const *data() const { return begin; }
+	size_t size() const { return length; }
+	bool packed() const { return !file; } //was the file found in a mounted pack?
+
+	std::string filename; //(for error messages)
+
+	//--- internals ---
+	char const *begin = nullptr;
+	size_t length = 0;
+	std::unique_ptr< MappedFile > file; //(only if the file wasn't in a pack)
+};
+
+//A DataStream is an istream that reads a DataFile (for loaders written against streams):
+struct DataStream : std::istream {
+	//open 'filename'; throws like DataFile:
+	DataStream(std::string const &filename);
+
+	DataFile file;
+
+	//--- internals ---
+	struct Buffer : std::streambuf {
+		Buffer(char const *begin, size_t size);
+		pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+		pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+	} buffer;
+};
+
+//Make the files in a pack readable through DataFile (and DataStream):
+// - files are found by the pack's directory + '/' + their name in the pack
+//    (so after mount_data_pack(data_path("data.pack")), DataFile(data_path("snake.pnct")) reads from the pack)
+// - the whole pack is read ahead as one sequential read (see MappedFile::prefetch)
+// - files whose loose copy is newer than the pack are left out (and read from disk), with a warning
+// - mount packs before loading starts (call_load_functions); they stay mounted until exit
+// - throws if the pack can't be mapped or is malformed
+void mount_data_pack(std::string const &pack_filename);
+
+//Pack index entries ("pak0"):
+struct DataPackEntry {
+	uint32_t name_begin, name_end; //range in "str0"
+	uint32_t data_begin, data_end; //range in "dat0"
+};
+static_assert(sizeof(DataPackEntry) == 4 * 4, "DataPackEntry is packed.");
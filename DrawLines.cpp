@@ -3,16 +3,17 @@
 #include "ColorProgram.hpp"
 
 #include "gl_errors.hpp"
+#include "gl_state.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
-//All DrawLines instances share a vertex array object and vertex buffer, initialized at load time:
+//All DrawLines instances share a vertex array object and vertex buffer, initialized the first time lines are drawn:
 
 //n.b. declared static so they don't conflict with similarly named global variables elsewhere:
 static GLuint vertex_buffer = 0;
 static GLuint vertex_buffer_for_color_program = 0;
 
-static Load< void > setup_buffers(LoadTagDefault, [](){
+static Load< void > setup_buffers(LoadOptions{"DrawLines buffers", LoadOnGLThread, {&color_program}, LoadOnFirstUse}, [](){
 	//you may recognize this init code from DrawSprites.cpp:
 
 	{ //set up vertex buffer:
@@ -25,10 +26,10 @@ static Load< void > setup_buffers(LoadTagDefault, [](){
 		glGenVertexArrays(1, &vertex_buffer_for_color_program);
 
 		//set vertex_buffer_for_color_program as the current vertex array object:
-		glBindVertexArray(vertex_buffer_for_color_program);
+		gl_state.bind_vertex_array(vertex_buffer_for_color_program);
 
 		//set vertex_buffer as the source of glVertexAttribPointer() commands:
-		glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
 
 		//set up the vertex array object to describe arrays of PongMode::Vertex:
 		glVertexAttribPointer(
@@ -53,10 +54,10 @@ static Load< void > setup_buffers(LoadTagDefault, [](){
 		glEnableVertexAttribArray(color_program->Color_vec4);
 
 		//done referring to vertex_buffer, so unbind it:
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, 0);
 
 		//done setting up vertex array object, so unbind it:
-		glBindVertexArray(0);
+		gl_state.bind_vertex_array(0);
 	}
 
 	GL_ERRORS(); //PARANOIA: make sure nothing strange happened during setup
@@ -135,30 +136,27 @@ void DrawLines::draw_text(std::string const &text, glm::vec3 const &anchor_in, g
 DrawLines::~DrawLines() {
 	if (attribs.empty()) return;
 
+	setup_buffers.require();
+
 	//based on DrawSprites.cpp :
 
 	//upload vertices to vertex_buffer:
-	glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer); //set vertex_buffer as current
+	gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer); //set vertex_buffer as current
 	glBufferData(GL_ARRAY_BUFFER, attribs.size() * sizeof(attribs[0]), attribs.data(), GL_STREAM_DRAW); //upload attribs array
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	//set color_program as current program:
-	glUseProgram(color_program->program);
+	gl_state.use_program(color_program->program);
 
 	//upload OBJECT_TO_CLIP to the proper uniform location:
 	glUniformMatrix4fv(color_program->OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(world_to_clip));
 
 	//use the mapping vertex_buffer_for_color_program to fetch vertex data:
-	glBindVertexArray(vertex_buffer_for_color_program);
+	gl_state.bind_vertex_array(vertex_buffer_for_color_program);
 
 	//run the OpenGL pipeline:
 	glDrawArrays(GL_LINES, 0, GLsizei(attribs.size()));
 
-	//reset vertex array to none:
-	glBindVertexArray(0);
-
-	//reset current program to none:
-	glUseProgram(0);
+	//(program and vertex array are left bound -- gl_state tracks them, so rebinding them next time is free)
 }
 
 
@@ -2,18 +2,24 @@
 
 #include "gl_compile_program.hpp"
 #include "gl_errors.hpp"
+#include "gl_state.hpp"
 
 Scene::Drawable::Pipeline lit_color_texture_program_pipeline;
 
-Load< LitColorTextureProgram > lit_color_texture_program(LoadTagEarly, []() -> LitColorTextureProgram const * {
+Load< LitColorTextureProgram > lit_color_texture_program(LoadOptions{"lit color texture program", LoadOnGLThread, {}, LoadOnFirstUse}, []() -> LitColorTextureProgram const * {
 	LitColorTextureProgram *ret = new LitColorTextureProgram();
 
 	//----- build the pipeline template -----
 	lit_color_texture_program_pipeline.program = ret->program;
 
+#ifdef LIT_COLOR_TEXTURE_OBJECT_MATRICES_BLOCK
+	//per-object matrices come from the ObjectMatrices uniform block (bound to ObjectMatricesBinding by the constructor):
+	lit_color_texture_program_pipeline.object_matrices_block = true;
+#else
 	lit_color_texture_program_pipeline.OBJECT_TO_CLIP_mat4 = ret->OBJECT_TO_CLIP_mat4;
 	lit_color_texture_program_pipeline.OBJECT_TO_LIGHT_mat4x3 = ret->OBJECT_TO_LIGHT_mat4x3;
 	lit_color_texture_program_pipeline.NORMAL_TO_LIGHT_mat3 = ret->NORMAL_TO_LIGHT_mat3;
+#endif
 
 	/* This will be used later if/when we build a light loop into the Scene:
 	lit_color_texture_program_pipeline.LIGHT_TYPE_int = ret->LIGHT_TYPE_int;
@@ -27,14 +33,14 @@ Load< LitColorTextureProgram > lit_color_texture_program(LoadTagEarly, []() -> L
 	GLuint tex;
 	glGenTextures(1, &tex);
 
-	glBindTexture(GL_TEXTURE_2D, tex);
+	gl_state.bind_texture(0, GL_TEXTURE_2D, tex);
 	std::vector< glm::u8vec4 > tex_data(1, glm::u8vec4(0xff));
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, tex_data.data());
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	gl_state.bind_texture(0, GL_TEXTURE_2D, 0);
 
 
 	lit_color_texture_program_pipeline.textures[0].texture = tex;
@@ -43,14 +49,61 @@ Load< LitColorTextureProgram > lit_color_texture_program(LoadTagEarly, []() -> L
 	return ret;
 });
 
-LitColorTextureProgram::LitColorTextureProgram() {
+std::set< std::string > const lit_color_texture_program_per_instance{ "InstanceObjectToWorld", "InstanceNormalToLight" };
+
+Load< LitColorTextureProgram > lit_color_texture_instanced_program(LoadOptions{"lit color texture program (instanced)", LoadOnGLThread, {}, LoadOnFirstUse}, []() -> LitColorTextureProgram const * {
+	LitColorTextureProgram *ret = new LitColorTextureProgram(true);
+
+	//----- add the instanced variant to the pipeline template -----
+	lit_color_texture_program_pipeline.instanced.program = ret->program;
+
+	lit_color_texture_program_pipeline.instanced.OBJECT_TO_WORLD_mat4x3 = ret->InstanceObjectToWorld_mat4x3;
+	lit_color_texture_program_pipeline.instanced.NORMAL_TO_LIGHT_mat3 = ret->InstanceNormalToLight_mat3;
+	lit_color_texture_program_pipeline.instanced.WORLD_TO_CLIP_mat4 = ret->WORLD_TO_CLIP_mat4;
+	lit_color_texture_program_pipeline.instanced.WORLD_TO_LIGHT_mat4x3 = ret->WORLD_TO_LIGHT_mat4x3;
+
+	return ret;
+});
+
+LitColorTextureProgram::LitColorTextureProgram(bool instanced) {
 	//Compile vertex and fragment shaders using the convenient 'gl_compile_program' helper function:
 	program = gl_compile_program(
 		//vertex shader:
+		instanced ? (
 		"#version 330\n"
+		"uniform mat4 WORLD_TO_CLIP;\n"
+		"uniform mat4x3 WORLD_TO_LIGHT;\n"
+		"in vec4 Position;\n"
+		"in vec3 Normal;\n"
+		"in vec4 Color;\n"
+		"in vec2 TexCoord;\n"
+		"in mat4x3 InstanceObjectToWorld;\n"
+		"in mat3 InstanceNormalToLight;\n"
+		"out vec3 position;\n"
+		"out vec3 normal;\n"
+		"out vec4 color;\n"
+		"out vec2 texCoord;\n"
+		"void main() {\n"
+		"	vec4 world = vec4(InstanceObjectToWorld * Position, 1.0);\n"
+		"	gl_Position = WORLD_TO_CLIP * world;\n"
+		"	position = WORLD_TO_LIGHT * world;\n"
+		"	normal = InstanceNormalToLight * Normal;\n"
+		"	color = Color;\n"
+		"	texCoord = TexCoord;\n"
+		"}\n"
+		) : (
+		"#version 330\n"
+#ifdef LIT_COLOR_TEXTURE_OBJECT_MATRICES_BLOCK
+		"layout(std140) uniform ObjectMatrices {\n"
+		"	mat4 OBJECT_TO_CLIP;\n"
+		"	mat4x3 OBJECT_TO_LIGHT;\n"
+		"	mat3 NORMAL_TO_LIGHT;\n"
+		"};\n"
+#else
 		"uniform mat4 OBJECT_TO_CLIP;\n"
 		"uniform mat4x3 OBJECT_TO_LIGHT;\n"
 		"uniform mat3 NORMAL_TO_LIGHT;\n"
+#endif
 		"in vec4 Position;\n"
 		"in vec3 Normal;\n"
 		"in vec4 Color;\n"
@@ -66,6 +119,7 @@ LitColorTextureProgram::LitColorTextureProgram() {
 		"	color = Color;\n"
 		"	texCoord = TexCoord;\n"
 		"}\n"
+		)
 	,
 		//fragment shader:
 		"#version 330\n"
@@ -114,11 +168,15 @@ LitColorTextureProgram::LitColorTextureProgram() {
 	Normal_vec3 = glGetAttribLocation(program, "Normal");
 	Color_vec4 = glGetAttribLocation(program, "Color");
 	TexCoord_vec2 = glGetAttribLocation(program, "TexCoord");
+	InstanceObjectToWorld_mat4x3 = glGetAttribLocation(program, "InstanceObjectToWorld");
+	InstanceNormalToLight_mat3 = glGetAttribLocation(program, "InstanceNormalToLight");
 
 	//look up the locations of uniforms:
 	OBJECT_TO_CLIP_mat4 = glGetUniformLocation(program, "OBJECT_TO_CLIP");
 	OBJECT_TO_LIGHT_mat4x3 = glGetUniformLocation(program, "OBJECT_TO_LIGHT");
 	NORMAL_TO_LIGHT_mat3 = glGetUniformLocation(program, "NORMAL_TO_LIGHT");
+	WORLD_TO_CLIP_mat4 = glGetUniformLocation(program, "WORLD_TO_CLIP");
+	WORLD_TO_LIGHT_mat4x3 = glGetUniformLocation(program, "WORLD_TO_LIGHT");
 
 	LIGHT_TYPE_int = glGetUniformLocation(program, "LIGHT_TYPE");
 	LIGHT_LOCATION_vec3 = glGetUniformLocation(program, "LIGHT_LOCATION");
@@ -127,14 +185,20 @@ LitColorTextureProgram::LitColorTextureProgram() {
 	LIGHT_CUTOFF_float = glGetUniformLocation(program, "LIGHT_CUTOFF");
 
 
+	//look up the per-object uniform block (if built with it), and have it read from the binding point that Scene::draw fills:
+	ObjectMatrices_block = glGetUniformBlockIndex(program, "ObjectMatrices");
+	if (ObjectMatrices_block != GL_INVALID_INDEX) {
+		glUniformBlockBinding(program, ObjectMatrices_block, Scene::Drawable::Pipeline::ObjectMatricesBinding);
+	}
+
 	GLuint TEX_sampler2D = glGetUniformLocation(program, "TEX");
 
 	//set TEX to always refer to texture binding zero:
-	glUseProgram(program); //bind program -- glUniform* calls refer to this program now
+	gl_state.use_program(program); //bind program -- glUniform* calls refer to this program now
 
 	glUniform1i(TEX_sampler2D, 0); //set TEX to sample from GL_TEXTURE0
 
-	glUseProgram(0); //unbind program -- glUniform* calls refer to ??? now
+	gl_state.use_program(0); //unbind program -- glUniform* calls refer to ??? now
 }
 
 LitColorTextureProgram::~LitColorTextureProgram() {
@@ -4,9 +4,15 @@
 #include "Load.hpp"
 #include "Scene.hpp"
 
+#include <set>
+#include <string>
+
 //Shader program that draws transformed, lit, textured vertices tinted with vertex colors:
+// the 'instanced' variant reads object transforms from per-instance attributes instead of uniforms (see Scene::Drawable::Pipeline::Instanced)
+// building with LIT_COLOR_TEXTURE_OBJECT_MATRICES_BLOCK defined makes the non-instanced variant read its per-object matrices
+//  from the ObjectMatrices uniform block instead of uniforms (see Scene::Drawable::Pipeline::object_matrices_block)
 struct LitColorTextureProgram {
-	LitColorTextureProgram();
+	LitColorTextureProgram(bool instanced = false);
 	~LitColorTextureProgram();
 
 	GLuint program = 0;
@@ -17,10 +23,21 @@ struct LitColorTextureProgram {
 	GLuint Color_vec4 = -1U;
 	GLuint TexCoord_vec2 = -1U;
 
+	//Attribute (per-instance variable) locations -- instanced variant only:
+	GLuint InstanceObjectToWorld_mat4x3 = -1U;
+	GLuint InstanceNormalToLight_mat3 = -1U;
+
 	//Uniform (per-invocation variable) locations:
 	GLuint OBJECT_TO_CLIP_mat4 = -1U;
 	GLuint OBJECT_TO_LIGHT_mat4x3 = -1U;
 	GLuint NORMAL_TO_LIGHT_mat3 = -1U;
+	// ..instanced variant only:
+	GLuint WORLD_TO_CLIP_mat4 = -1U;
+	GLuint WORLD_TO_LIGHT_mat4x3 = -1U;
+
+	//Uniform block index -- non-instanced variant built with LIT_COLOR_TEXTURE_OBJECT_MATRICES_BLOCK only:
+	// (ObjectMatrices holds OBJECT_TO_CLIP, OBJECT_TO_LIGHT, and NORMAL_TO_LIGHT, whose uniform locations are then -1U)
+	GLuint ObjectMatrices_block = -1U;
 
 	//lighting:
 	GLuint LIGHT_TYPE_int = -1U;
@@ -34,7 +51,12 @@ struct LitColorTextureProgram {
 };
 
 extern Load< LitColorTextureProgram > lit_color_texture_program;
+extern Load< LitColorTextureProgram > lit_color_texture_instanced_program;
+
+//names of the per-instance attributes (to pass to MeshBuffer::make_vao_for_program for the instanced variant):
+extern std::set< std::string > const lit_color_texture_program_per_instance;
 
 //For convenient scene-graph setup, copy this object:
 // NOTE: by default, has texture bound to 1-pixel white texture -- so it's okay to use with vertex-color-only meshes.
+// NOTE: also has instanced.program set; set instanced.vao (from a VAO made for lit_color_texture_instanced_program) to allow instancing.
 extern Scene::Drawable::Pipeline lit_color_texture_program_pipeline;
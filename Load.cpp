@@ -1,32 +1,872 @@
 #include "Load.hpp"
 
-#include <array>
-#include <list>
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#include <time.h>
+#endif
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
 
 namespace {
-	std::array< std::list< std::function< void() > >, MaxLoadTag > &get_load_lists() {
-		static std::array< std::list< std::function< void() > >, MaxLoadTag > load_lists;
-		return load_lists;
+	struct LoadEntry {
+		LoadBase *owner = nullptr; //(null for plain functions added with add_load_function)
+		LoadTag tag = LoadTagDefault;
+		bool tag_only = true;
+		bool prefetch = false; //(LoadOnFirstUse loads prefetched before call_load_functions() run at startup)
+		LoadOptions options;
+		std::function< void() > fn;
+		std::function< std::function< void() >() > reload; //(see set_reload_function())
+
+		//filled in by call_load_functions():
+		std::vector< uint32_t > needs; //loads this one depends on
+		std::vector< uint32_t > needed_by; //loads that depend on this one
+		std::vector< uint32_t > used_by; //loads that list this one in 'after' (rerun by hot reload when this one is)
+		bool at_startup = false; //run by call_load_functions() (LoadAtStartup, or needed by such a load, or prefetched)
+
+		//startup scheduling (guarded by call_load_functions()'s mutex):
+		uint32_t waiting = 0; //dependencies that haven't finished yet
+		bool skipped = false;
+		uint32_t skipped_for = -1U; //dependency that failed or was skipped (if skipped)
+
+		//running the load (guarded by 'mutex', which is held while 'fn' runs, so each load runs once):
+		std::mutex mutex;
+		enum State { Waiting, Done, Failed } state = Waiting;
+		std::string error; //(if Failed)
+		std::atomic< bool > finished{false}; //state != Waiting (checked without the lock)
+
+		//statistics (written by the thread running the load; read once it has finished):
+		struct Stats {
+			bool ran = false;
+			double start = 0.0; //seconds after call_load_functions() started
+			double wall = 0.0, cpu = 0.0; //seconds (not counting other loads it used, which ran inside it)
+			uint64_t bytes_read = 0, bytes_uploaded = 0; //(as counted by count_load_read() / count_load_upload())
+			uint32_t thread = 0;
+		} stats;
+	};
+
+	//(a deque, so entries -- and their mutexes -- stay put as more are added)
+	std::deque< LoadEntry > &get_load_entries() {
+		static std::deque< LoadEntry > load_entries;
+		return load_entries;
 	}
+
+	bool load_functions_called = false;
+	std::thread::id gl_thread; //(the thread that called call_load_functions())
+	std::chrono::steady_clock::time_point load_epoch; //(when call_load_functions() started)
+
+	//----- statistics -----
+
+	//the load running on this thread (if any), which the counters charge:
+	struct Running {
+		LoadEntry::Stats *stats;
+		Running *outer; //(a load can use a LoadOnFirstUse load, which then runs inside it)
+		std::chrono::steady_clock::time_point wall_start;
+		double cpu_start;
+		double inner_wall = 0.0, inner_cpu = 0.0; //time spent in loads run inside this one
+	};
+	thread_local Running *current_load = nullptr;
+
+	double thread_cpu_seconds() {
+	#ifdef _WIN32
+		FILETIME creation, exit, kernel, user;
+		if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) return 0.0;
+		auto ticks = [](FILETIME const &t) { return (uint64_t(t.dwHighDateTime) << 32) | uint64_t(t.dwLowDateTime); };
+		return double(ticks(kernel) + ticks(user)) * 1e-7;
+	#else
+		timespec ts;
+		if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0.0;
+		return double(ts.tv_sec) + double(ts.tv_nsec) * 1e-9;
+	#endif
+	}
+
+	//most memory the process has had resident so far (0 if unknown):
+	// (loads run concurrently, so memory can't be charged to each one; the report shows how much this grew while loading)
+	uint64_t peak_rss_bytes() {
+	#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+		return uint64_t(counters.PeakWorkingSetSize);
+	#else
+		rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+		#ifdef __APPLE__
+		return uint64_t(usage.ru_maxrss); //(bytes on macOS)
+		#else
+		return uint64_t(usage.ru_maxrss) * 1024; //(KiB on Linux)
+		#endif
+	#endif
+	}
+	uint64_t peak_rss_at_start = 0; //(when call_load_functions() started)
+
+	//small per-thread numbers, for the report:
+	uint32_t this_thread_number() {
+		static std::atomic< uint32_t > next{0};
+		thread_local uint32_t number = next++;
+		return number;
+	}
+
+	//run entry 'i' (and, first, anything it needs) on this thread, unless it has already run:
+	// (throws if it -- or something it needs -- failed)
+	void load_entry(uint32_t i) {
+		LoadEntry &entry = get_load_entries()[i];
+		auto failed = [&]() {
+			return std::runtime_error("Loading '" + entry.options.name + "' failed: " + entry.error);
+		};
+		if (entry.finished.load(std::memory_order_acquire)) {
+			if (entry.state == LoadEntry::Failed) throw failed();
+			return;
+		}
+		if (!load_functions_called) {
+			throw std::runtime_error("Load '" + entry.options.name + "' was used before call_load_functions().");
+		}
+
+		//loads this thread is in the middle of (so a load that uses itself throws instead of deadlocking):
+		thread_local std::vector< uint32_t > running_here;
+		if (std::find(running_here.begin(), running_here.end(), i) != running_here.end()) {
+			throw std::runtime_error("Load '" + entry.options.name + "' is part of a dependency cycle.");
+		}
+
+		std::unique_lock< std::mutex > lock(entry.mutex);
+		if (entry.state == LoadEntry::Done) return;
+		if (entry.state == LoadEntry::Failed) throw failed();
+		if (entry.options.thread == LoadOnGLThread && std::this_thread::get_id() != gl_thread) {
+			throw std::runtime_error("Load '" + entry.options.name + "' needs the GL thread, but was first used on another thread.");
+		}
+
+		running_here.emplace_back(i);
+		try {
+			for (uint32_t need : entry.needs) {
+				load_entry(need);
+			}
+			Running run;
+			run.stats = &entry.stats;
+			run.outer = current_load;
+			run.cpu_start = thread_cpu_seconds();
+			run.wall_start = std::chrono::steady_clock::now();
+			entry.stats.ran = true;
+			entry.stats.start = std::chrono::duration< double >(run.wall_start - load_epoch).count();
+			entry.stats.thread = this_thread_number();
+			current_load = &run;
+
+			struct Finish { //(so stats are kept even if fn() throws)
+				Running &run;
+				~Finish() {
+					current_load = run.outer;
+					double wall = std::chrono::duration< double >(std::chrono::steady_clock::now() - run.wall_start).count();
+					double cpu = thread_cpu_seconds() - run.cpu_start;
+					run.stats->wall = wall - run.inner_wall;
+					run.stats->cpu = cpu - run.inner_cpu;
+					if (run.outer) {
+						run.outer->inner_wall += wall;
+						run.outer->inner_cpu += cpu;
+					}
+				}
+			} finish{run};
+
+			entry.fn();
+			entry.state = LoadEntry::Done;
+		} catch (std::exception const &e) {
+			entry.state = LoadEntry::Failed;
+			entry.error = e.what();
+		} catch (...) {
+			entry.state = LoadEntry::Failed;
+			entry.error = "unknown exception";
+		}
+		running_here.pop_back();
+		entry.finished.store(true, std::memory_order_release);
+
+		if (entry.state == LoadEntry::Failed) throw failed();
+	}
+
+	//runs LoadOnAnyThread loads that were prefetched after startup:
+	struct Prefetcher {
+		std::mutex mutex;
+		std::condition_variable changed;
+		std::deque< uint32_t > queue;
+		bool quit = false;
+		std::thread thread; //(declared last, so it starts after everything it uses exists)
+
+		Prefetcher() : thread([this](){
+			std::unique_lock< std::mutex > lock(mutex);
+			while (true) {
+				changed.wait(lock, [this](){ return quit || !queue.empty(); });
+				if (quit) return;
+				uint32_t i = queue.front();
+				queue.pop_front();
+				lock.unlock();
+				try {
+					load_entry(i);
+				} catch (...) {
+					//(failure is kept in the entry and thrown at first use)
+				}
+				lock.lock();
+			}
+		}) { }
+		~Prefetcher() {
+			{
+				std::unique_lock< std::mutex > lock(mutex);
+				quit = true; //(anything still queued is left for first use)
+			}
+			changed.notify_all();
+			thread.join();
+		}
+
+		static Prefetcher &get() {
+			static Prefetcher prefetcher;
+			return prefetcher;
+		}
+	};
+}
+
+void add_load_function(LoadTag tag, std::function< void() > const &fn, LoadBase *owner) {
+	assert(tag < MaxLoadTag);
+	assert(!load_functions_called && "add_load_function should only be called before call_load_functions");
+	auto &load_entries = get_load_entries();
+	load_entries.emplace_back();
+	LoadEntry &entry = load_entries.back();
+	entry.owner = owner;
+	entry.tag = tag;
+	entry.tag_only = true;
+	entry.options.name = "load function #" + std::to_string(load_entries.size() - 1) + " (tag " + std::to_string(uint32_t(tag)) + ")";
+	entry.options.thread = LoadOnGLThread;
+	entry.fn = fn;
+	if (owner) owner->load_index = uint32_t(load_entries.size() - 1);
 }
 
-void add_load_function(LoadTag tag, std::function< void() > const &fn) {
-	auto &load_lists = get_load_lists();
-	assert(tag < load_lists.size());
-	load_lists[tag].emplace_back(fn);
+void add_load_function(LoadBase *owner, LoadOptions const &options, std::function< void() > const &fn) {
+	assert(owner);
+	assert(!load_functions_called && "add_load_function should only be called before call_load_functions");
+	auto &load_entries = get_load_entries();
+	load_entries.emplace_back();
+	LoadEntry &entry = load_entries.back();
+	entry.owner = owner;
+	entry.tag_only = false;
+	entry.options = options;
+	if (entry.options.name.empty()) entry.options.name = "load function #" + std::to_string(load_entries.size() - 1);
+	entry.fn = fn;
+	owner->load_index = uint32_t(load_entries.size() - 1);
+}
+
+void set_reload_function(LoadBase *owner, std::function< std::function< void() >() > const &reload) {
+	assert(owner && owner->load_index != -1U);
+	get_load_entries()[owner->load_index].reload = reload;
+}
+
+void LoadBase::require() const {
+	if (load_index == -1U) {
+		throw std::runtime_error("Load was used, but never added with add_load_function().");
+	}
+	load_entry(load_index);
+}
+
+void LoadBase::prefetch() const {
+	if (load_index == -1U) return;
+	LoadEntry &entry = get_load_entries()[load_index];
+	if (!load_functions_called) {
+		entry.prefetch = true;
+		return;
+	}
+	if (entry.finished.load(std::memory_order_acquire)) return;
+	if (entry.options.thread == LoadOnGLThread) {
+		if (std::this_thread::get_id() != gl_thread) return;
+		try {
+			load_entry(load_index);
+		} catch (...) {
+			//(failure is kept in the entry and thrown at first use)
+		}
+	} else {
+		Prefetcher &prefetcher = Prefetcher::get();
+		{
+			std::unique_lock< std::mutex > lock(prefetcher.mutex);
+			prefetcher.queue.emplace_back(load_index);
+		}
+		prefetcher.changed.notify_one();
+	}
 }
 
 void call_load_functions() {
-	static bool has_been_called = false;
-	assert(!has_been_called && "call_load_functions should only be called *once*");
-	has_been_called = true;
+	assert(!load_functions_called && "call_load_functions should only be called *once*");
+	load_functions_called = true;
+	gl_thread = std::this_thread::get_id();
+	load_epoch = std::chrono::steady_clock::now();
+	peak_rss_at_start = peak_rss_bytes();
+	this_thread_number(); //(so the GL thread is thread 0 in the report)
+
+	auto &entries = get_load_entries();
+
+	{ //build the dependency graph:
+		auto add_need = [&](uint32_t entry, uint32_t need) {
+			entries[entry].needs.emplace_back(need);
+			entries[need].needed_by.emplace_back(entry);
+		};
+
+		//tag-only loads keep their old order (by tag, then in the order they were added) by each needing the previous one:
+		std::vector< uint32_t > tag_only;
+		for (uint32_t i = 0; i < entries.size(); ++i) {
+			if (entries[i].tag_only) tag_only.emplace_back(i);
+		}
+		std::stable_sort(tag_only.begin(), tag_only.end(), [&](uint32_t a, uint32_t b) {
+			return entries[a].tag < entries[b].tag;
+		});
+		for (uint32_t t = 1; t < tag_only.size(); ++t) {
+			add_need(tag_only[t], tag_only[t-1]);
+		}
+
+		for (uint32_t i = 0; i < entries.size(); ++i) {
+			for (LoadBase const *after : entries[i].options.after) {
+				if (after->load_index == -1U) {
+					throw std::runtime_error("Load '" + entries[i].options.name + "' depends on a load that was never added.");
+				}
+				add_need(i, after->load_index);
+				entries[after->load_index].used_by.emplace_back(i);
+			}
+		}
+	}
+
+	{ //startup runs LoadAtStartup (and prefetched) loads, and everything they need:
+		std::vector< uint32_t > todo;
+		for (uint32_t i = 0; i < entries.size(); ++i) {
+			if (entries[i].options.when == LoadAtStartup || entries[i].prefetch) todo.emplace_back(i);
+		}
+		while (!todo.empty()) {
+			uint32_t i = todo.back();
+			todo.pop_back();
+			if (entries[i].at_startup) continue;
+			entries[i].at_startup = true;
+			todo.insert(todo.end(), entries[i].needs.begin(), entries[i].needs.end());
+		}
+		for (auto &entry : entries) {
+			if (entry.at_startup) entry.waiting = uint32_t(entry.needs.size());
+		}
+	}
+
+	//----- run startup loads as their dependencies finish -----
+	std::mutex mutex; //guards everything below, and entries' scheduling state
+	std::condition_variable changed; //signalled when a load becomes ready or finishes (or on shutdown)
+	std::deque< uint32_t > ready_gl, ready_any;
+	uint32_t remaining = 0; //startup loads not yet finished or skipped
+	uint32_t running = 0;
+	bool quit = false;
+
+	auto make_ready = [&](uint32_t i) {
+		if (entries[i].options.thread == LoadOnAnyThread) ready_any.emplace_back(i);
+		else ready_gl.emplace_back(i);
+	};
+
+	//(call with mutex held)
+	std::function< void(uint32_t, uint32_t) > skip = [&](uint32_t i, uint32_t because) {
+		if (!entries[i].at_startup || entries[i].skipped) return;
+		entries[i].skipped = true;
+		entries[i].skipped_for = because;
+		remaining -= 1;
+		for (uint32_t d : entries[i].needed_by) skip(d, i);
+	};
+
+	//(call with mutex held)
+	auto finish = [&](uint32_t i, bool ok) {
+		remaining -= 1;
+		for (uint32_t d : entries[i].needed_by) {
+			if (!entries[d].at_startup) continue; //(LoadOnFirstUse loads run when used)
+			if (!ok) {
+				skip(d, i);
+			} else if (--entries[d].waiting == 0 && !entries[d].skipped) {
+				make_ready(d);
+			}
+		}
+		changed.notify_all();
+	};
+
+	auto run = [&](uint32_t i, std::unique_lock< std::mutex > &lock) {
+		running += 1;
+		lock.unlock();
+		bool ok = true;
+		//exceptions can't leave a loader thread, so they are kept in the entry and reported at the end:
+		// (the load may already have run, if something used it first)
+		try {
+			load_entry(i);
+		} catch (...) {
+			ok = false;
+		}
+		lock.lock();
+		running -= 1;
+		finish(i, ok);
+	};
+
+	for (uint32_t i = 0; i < entries.size(); ++i) {
+		if (!entries[i].at_startup) continue;
+		remaining += 1;
+		if (entries[i].waiting == 0) make_ready(i);
+	}
+
+	//loader threads run CPU-only loads:
+	// (no more threads than there are such loads; the main thread helps out when it has no GL loads to run)
+	uint32_t any_count = uint32_t(std::count_if(entries.begin(), entries.end(), [](LoadEntry const &entry) {
+		return entry.at_startup && entry.options.thread == LoadOnAnyThread;
+	}));
+	uint32_t thread_count = std::min(std::max(std::thread::hardware_concurrency(), 1U) - 1, any_count);
+	std::vector< std::thread > threads;
+	threads.reserve(thread_count);
+	for (uint32_t t = 0; t < thread_count; ++t) {
+		threads.emplace_back([&](){
+			std::unique_lock< std::mutex > lock(mutex);
+			while (true) {
+				changed.wait(lock, [&](){ return quit || !ready_any.empty(); });
+				if (quit) return;
+				uint32_t i = ready_any.front();
+				ready_any.pop_front();
+				run(i, lock);
+			}
+		});
+	}
+
+	{ //main thread runs GL loads (and CPU-only loads, when it would otherwise wait):
+		std::unique_lock< std::mutex > lock(mutex);
+		while (remaining > 0) {
+			if (!ready_gl.empty()) {
+				uint32_t i = ready_gl.front();
+				ready_gl.pop_front();
+				run(i, lock);
+			} else if (!ready_any.empty()) {
+				uint32_t i = ready_any.front();
+				ready_any.pop_front();
+				run(i, lock);
+			} else if (running == 0) {
+				//nothing ready or running, but loads remain -- they must need each other:
+				for (auto &entry : entries) {
+					if (!entry.at_startup || entry.skipped) continue;
+					std::unique_lock< std::mutex > entry_lock(entry.mutex);
+					if (entry.state == LoadEntry::Waiting) {
+						entry.state = LoadEntry::Failed;
+						entry.error = "dependency cycle";
+						entry.finished.store(true, std::memory_order_release);
+						remaining -= 1;
+					}
+				}
+			} else {
+				changed.wait(lock);
+			}
+		}
+		quit = true;
+	}
+	changed.notify_all();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	//----- report failures (with the chain of dependencies that led to each skipped load) -----
+	std::string report;
+	for (auto const &entry : entries) {
+		if (entry.at_startup && entry.state == LoadEntry::Failed) {
+			report += "\n  '" + entry.options.name + "' failed: " + entry.error;
+		}
+	}
+	for (auto const &entry : entries) {
+		if (entry.skipped) {
+			report += "\n  '" + entry.options.name + "' skipped: needs";
+			for (uint32_t i = entry.skipped_for; i != -1U; i = entries[i].skipped_for) {
+				report += " '" + entries[i].options.name + "'";
+				if (entries[i].state == LoadEntry::Failed) report += " (failed)";
+				else report += ", which needs";
+			}
+		}
+	}
+
+	report_load_stats();
 
-	auto &load_lists = get_load_lists();
-	for (auto &fn_list : load_lists) {
-		while (!fn_list.empty()) {
-			(*fn_list.begin())(); //call first function in the list
-			fn_list.pop_front(); //remove from list
+	if (!report.empty()) {
+		throw std::runtime_error("Loading failed:" + report);
+	}
+}
+
+void count_load_read(size_t bytes) {
+	if (current_load) current_load->stats->bytes_read += bytes;
+}
+
+void count_load_upload(size_t bytes) {
+	if (current_load) current_load->stats->bytes_uploaded += bytes;
+}
+
+namespace {
+	//loads that have run, slowest first:
+	std::vector< LoadEntry const * > loads_that_ran() {
+		std::vector< LoadEntry const * > ran;
+		for (auto const &entry : get_load_entries()) {
+			if (entry.finished.load(std::memory_order_acquire) && entry.stats.ran) ran.emplace_back(&entry);
+		}
+		std::stable_sort(ran.begin(), ran.end(), [](LoadEntry const *a, LoadEntry const *b) {
+			return a->stats.wall > b->stats.wall;
+		});
+		return ran;
+	}
+}
+
+void report_load_stats() {
+	std::vector< LoadEntry const * > ran = loads_that_ran();
+	if (ran.empty()) return;
+
+	double end = 0.0;
+	double cpu = 0.0;
+	uint64_t bytes_read = 0;
+	uint64_t bytes_uploaded = 0;
+	for (LoadEntry const *entry : ran) {
+		end = std::max(end, entry->stats.start + entry->stats.wall);
+		cpu += entry->stats.cpu;
+		bytes_read += entry->stats.bytes_read;
+		bytes_uploaded += entry->stats.bytes_uploaded;
+	}
+
+	uint64_t peak_rss = peak_rss_bytes();
+	uint64_t peak_rss_growth = (peak_rss > peak_rss_at_start ? peak_rss - peak_rss_at_start : 0);
+
+	auto kib = [](uint64_t bytes) { return double(bytes) / 1024.0; };
+	std::cout << "Ran " << ran.size() << " loads in " << std::fixed << std::setprecision(1) << end * 1000.0 << " ms"
+	          << " (" << cpu * 1000.0 << " ms cpu, " << kib(bytes_read) << " KiB read, " << kib(bytes_uploaded) << " KiB uploaded,"
+	          << " peak RSS +" << kib(peak_rss_growth) << " KiB):\n";
+	std::cout << std::right << std::setw(10) << "wall ms" << std::setw(10) << "cpu ms"
+	          << std::setw(12) << "read KiB" << std::setw(12) << "upload KiB"
+	          << std::setw(8) << "thread" << "  name\n";
+	for (LoadEntry const *entry : ran) {
+		LoadEntry::Stats const &stats = entry->stats;
+		std::cout << std::setw(10) << stats.wall * 1000.0 << std::setw(10) << stats.cpu * 1000.0
+		          << std::setw(12) << kib(stats.bytes_read) << std::setw(12) << kib(stats.bytes_uploaded)
+		          << std::setw(8) << stats.thread << "  " << entry->options.name
+		          << (entry->state == LoadEntry::Failed ? " (failed)" : "") << '\n';
+	}
+	std::cout.unsetf(std::ios::floatfield);
+	std::cout << std::setprecision(6);
+	std::cout.flush();
+}
+
+void write_load_trace(std::string const &filename) {
+	auto quote = [](std::string const &str) {
+		std::string ret = "\"";
+		for (char c : str) {
+			if (c == '"' || c == '\\') {
+				ret += '\\';
+				ret += c;
+			} else if (uint8_t(c) < 0x20) {
+				char buf[8];
+				std::snprintf(buf, sizeof(buf), "\\u%04x", uint32_t(uint8_t(c)));
+				ret += buf;
+			} else {
+				ret += c;
+			}
+		}
+		return ret + "\"";
+	};
+
+	std::ofstream out(filename, std::ios::binary);
+	if (!out) {
+		throw std::runtime_error("Failed to open '" + filename + "' to write the load trace.");
+	}
+
+	//Chrome trace event format (open in chrome://tracing or ui.perfetto.dev):
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GL thread\"}}";
+	out << std::fixed << std::setprecision(3);
+	for (LoadEntry const *entry : loads_that_ran()) {
+		LoadEntry::Stats const &stats = entry->stats;
+		out << ",\n{\"name\":" << quote(entry->options.name) << ",\"cat\":\"load\",\"ph\":\"X\",\"pid\":1"
+		    << ",\"tid\":" << stats.thread
+		    << ",\"ts\":" << stats.start * 1e6 << ",\"dur\":" << stats.wall * 1e6
+		    << ",\"args\":{\"cpu_ms\":" << stats.cpu * 1e3
+		    << ",\"bytes_read\":" << stats.bytes_read
+		    << ",\"bytes_uploaded\":" << stats.bytes_uploaded
+		    << ",\"failed\":" << (entry->state == LoadEntry::Failed ? "true" : "false")
+		    << "}}";
+	}
+	out << "\n]}\n";
+	if (!out) {
+		throw std::runtime_error("Failed to write load trace to '" + filename + "'.");
+	}
+}
+
+//----- hot reload -----
+
+namespace {
+	struct HotReload {
+		bool started = false;
+
+		//watched files, and the loads that read each one:
+		std::vector< std::string > files;
+		std::vector< std::vector< uint32_t > > file_loads;
+		std::vector< bool > changed; //per entry: a file it watches has changed since its last reload
+
+	#ifdef __linux__
+		int inotify = -1;
+		std::unordered_map< int, std::filesystem::path > directories; //watch descriptor -> directory (empty for the working directory)
+	#else
+		std::vector< std::filesystem::file_time_type > times; //per file: last write time seen
+		std::chrono::steady_clock::time_point next_poll;
+	#endif
+
+		//loads being reloaded, in dependency order:
+		std::vector< uint32_t > batch;
+		size_t next = 0; //next in 'batch' to reload
+		std::chrono::steady_clock::time_point started_at; //(when batch[next] started)
+
+		//LoadOnAnyThread loads reload on this thread, then get swapped in by update_hot_reload():
+		std::thread thread;
+		std::atomic< bool > thread_done{false};
+		bool ok = false;
+		std::function< void() > swap;
+		std::string error;
+
+		~HotReload() {
+			if (thread.joinable()) thread.join();
+		#ifdef __linux__
+			if (inotify != -1) close(inotify);
+		#endif
+		}
+	};
+
+	HotReload &get_hot_reload() {
+		static HotReload hot_reload;
+		return hot_reload;
+	}
+
+	//mark the loads that watch 'file' as changed:
+	void file_changed(HotReload &hr, std::string const &file) {
+		for (uint32_t f = 0; f < hr.files.size(); ++f) {
+			if (hr.files[f] != file) continue;
+			for (uint32_t i : hr.file_loads[f]) hr.changed[i] = true;
+		}
+	}
+
+	void poll_files(HotReload &hr) {
+	#ifdef __linux__
+		alignas(inotify_event) char buffer[4096];
+		ssize_t got;
+		while ((got = read(hr.inotify, buffer, sizeof(buffer))) > 0) {
+			for (char const *at = buffer; at < buffer + got; ) {
+				inotify_event const *event = reinterpret_cast< inotify_event const * >(at);
+				at += sizeof(inotify_event) + event->len;
+				auto f = hr.directories.find(event->wd);
+				if (f == hr.directories.end() || event->len == 0) continue;
+				//(joined the same way the file's name was split, so it matches the watched name)
+				file_changed(hr, f->second.empty() ? std::string(event->name) : (f->second / event->name).string());
+			}
 		}
+	#else
+		auto now = std::chrono::steady_clock::now();
+		if (now < hr.next_poll) return;
+		hr.next_poll = now + std::chrono::milliseconds(250);
+		for (uint32_t f = 0; f < hr.files.size(); ++f) {
+			std::error_code ec;
+			auto time = std::filesystem::last_write_time(hr.files[f], ec);
+			if (ec || time == hr.times[f]) continue;
+			hr.times[f] = time;
+			file_changed(hr, hr.files[f]);
+		}
+	#endif
+	}
+
+	//start a batch with the changed loads and everything that depends on them (that has loaded and can be reloaded):
+	void start_batch(HotReload &hr) {
+		auto &entries = get_load_entries();
+		auto reloadable = [&](uint32_t i) {
+			return entries[i].reload && entries[i].finished.load(std::memory_order_acquire) && entries[i].state == LoadEntry::Done;
+		};
+
+		std::vector< bool > in_batch(entries.size(), false);
+		std::vector< uint32_t > todo;
+		for (uint32_t i = 0; i < entries.size(); ++i) {
+			if (hr.changed[i]) todo.emplace_back(i);
+		}
+		hr.changed.assign(entries.size(), false);
+		while (!todo.empty()) {
+			uint32_t i = todo.back();
+			todo.pop_back();
+			if (in_batch[i] || !reloadable(i)) continue;
+			in_batch[i] = true;
+			todo.insert(todo.end(), entries[i].used_by.begin(), entries[i].used_by.end());
+		}
+
+		//order so each load comes after everything it needs that is also being reloaded:
+		hr.batch.clear();
+		hr.next = 0;
+		std::vector< bool > placed(entries.size(), false);
+		std::function< void(uint32_t) > place = [&](uint32_t i) {
+			if (placed[i]) return;
+			placed[i] = true;
+			for (uint32_t need : entries[i].needs) {
+				if (in_batch[need]) place(need);
+			}
+			hr.batch.emplace_back(i);
+		};
+		for (uint32_t i = 0; i < entries.size(); ++i) {
+			if (in_batch[i]) place(i);
+		}
+	}
+
+	//swap in (or report the failure of) batch[next]:
+	void finish_reload(HotReload &hr, bool ok, std::function< void() > const &swap, std::string const &error) {
+		LoadEntry &entry = get_load_entries()[hr.batch[hr.next]];
+		if (!ok) {
+			std::cerr << "Reloading '" << entry.options.name << "' failed (keeping the old value): " << error << std::endl;
+			//(loads that depend on it don't need to reload, so drop the rest of the batch)
+			hr.batch.clear();
+			hr.next = 0;
+			return;
+		}
+		if (swap) swap();
+		entry.owner->generation += 1;
+		double ms = std::chrono::duration< double, std::milli >(std::chrono::steady_clock::now() - hr.started_at).count();
+		std::cout << "Reloaded '" << entry.options.name << "' in " << std::fixed << std::setprecision(1) << ms << " ms." << std::endl;
+		std::cout.unsetf(std::ios::floatfield);
+		std::cout << std::setprecision(6);
+		hr.next += 1;
+	}
+}
+
+void start_hot_reload() {
+	assert(load_functions_called && "start_hot_reload should be called after call_load_functions");
+	HotReload &hr = get_hot_reload();
+	if (hr.started) return;
+	hr.started = true;
+
+	auto &entries = get_load_entries();
+	hr.changed.assign(entries.size(), false);
+	for (uint32_t i = 0; i < entries.size(); ++i) {
+		if (!entries[i].options.watch.empty() && !entries[i].reload) {
+			std::cerr << "WARNING: '" << entries[i].options.name << "' watches files, but has no reload function, so it won't be reloaded." << std::endl;
+		}
+		for (auto const &file : entries[i].options.watch) {
+			auto f = std::find(hr.files.begin(), hr.files.end(), file);
+			if (f == hr.files.end()) {
+				hr.files.emplace_back(file);
+				hr.file_loads.emplace_back();
+				f = hr.files.end() - 1;
+			}
+			hr.file_loads[f - hr.files.begin()].emplace_back(i);
+		}
+	}
+
+#ifdef __linux__
+	//watch the directories (not the files), since editors and exporters often replace a file instead of writing it in place:
+	hr.inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (hr.inotify == -1) {
+		std::cerr << "WARNING: inotify_init1 failed; hot reload is off." << std::endl;
+		return;
+	}
+	for (auto const &file : hr.files) {
+		std::filesystem::path directory = std::filesystem::path(file).parent_path();
+		std::string watch = (directory.empty() ? std::string(".") : directory.string());
+		int wd = inotify_add_watch(hr.inotify, watch.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		if (wd == -1) {
+			std::cerr << "WARNING: can't watch '" << watch << "' for changes to '" << file << "'." << std::endl;
+			continue;
+		}
+		hr.directories[wd] = directory;
+	}
+#else
+	hr.times.resize(hr.files.size());
+	for (uint32_t f = 0; f < hr.files.size(); ++f) {
+		std::error_code ec;
+		hr.times[f] = std::filesystem::last_write_time(hr.files[f], ec);
+	}
+#endif
+
+	std::cout << "Hot reload: watching " << hr.files.size() << " files." << std::endl;
+}
+
+void update_hot_reload() {
+	HotReload &hr = get_hot_reload();
+	if (!hr.started) return;
+	assert(std::this_thread::get_id() == gl_thread && "update_hot_reload should be called on the GL thread");
+
+	poll_files(hr);
+
+	auto &entries = get_load_entries();
+	while (true) {
+		if (hr.thread.joinable()) { //a LoadOnAnyThread reload is running:
+			if (!hr.thread_done.load(std::memory_order_acquire)) return; //(check again next frame)
+			hr.thread.join();
+			finish_reload(hr, hr.ok, hr.swap, hr.error);
+			hr.swap = nullptr;
+			continue;
+		}
+		if (hr.next >= hr.batch.size()) {
+			if (std::find(hr.changed.begin(), hr.changed.end(), true) == hr.changed.end()) return;
+			start_batch(hr);
+			if (hr.batch.empty()) return;
+		}
+
+		uint32_t i = hr.batch[hr.next];
+		hr.started_at = std::chrono::steady_clock::now();
+		if (entries[i].options.thread == LoadOnAnyThread) {
+			hr.thread_done = false;
+			hr.ok = false;
+			hr.error.clear();
+			hr.thread = std::thread([&hr,i](){
+				try {
+					hr.swap = get_load_entries()[i].reload();
+					hr.ok = true;
+				} catch (std::exception const &e) {
+					hr.error = e.what();
+				} catch (...) {
+					hr.error = "unknown exception";
+				}
+				hr.thread_done.store(true, std::memory_order_release);
+			});
+			return;
+		}
+
+		//LoadOnGLThread loads reload right here (between frames):
+		std::function< void() > swap;
+		std::string error;
+		bool ok = false;
+		try {
+			swap = entries[i].reload();
+			ok = true;
+		} catch (std::exception const &e) {
+			error = e.what();
+		} catch (...) {
+			error = "unknown exception";
+		}
+		finish_reload(hr, ok, swap, error);
+	}
+}
+
+void report_unused_loads() {
+	std::vector< std::string > loaded, never_loaded;
+	for (auto &entry : get_load_entries()) {
+		if (!entry.owner || entry.owner->used.load()) continue;
+		if (!entry.finished.load(std::memory_order_acquire)) never_loaded.emplace_back(entry.options.name);
+		else if (entry.state == LoadEntry::Done) loaded.emplace_back(entry.options.name);
+		//(failed loads were already reported when they were used)
+	}
+	if (loaded.empty() && never_loaded.empty()) return;
+
+	std::cout << "Loads never used this session:\n";
+	for (auto const &name : loaded) {
+		std::cout << "  '" << name << "' (loaded anyway -- could it be LoadOnFirstUse?)\n";
+	}
+	for (auto const &name : never_loaded) {
+		std::cout << "  '" << name << "' (never loaded)\n";
 	}
+	std::cout.flush();
 }
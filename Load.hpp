@@ -20,10 +20,42 @@
  * These functions are grouped by 'tags', which allow some sequencing of calls.
  * (particularly, this is useful for loading large data blobs [e.g. Meshes] before looking up individual elements within them.)
  *
+ * Loads can instead be given LoadOptions, naming the other loads they need and whether they need the GL thread:
+ *
+ * Load< Scene > level(LoadOptions{"level.scene", LoadOnAnyThread, {&level_meshes}}, []() -> Scene const * {
+ *     ...
+ * });
+ *
+ * call_load_functions() runs loads as soon as what they need has finished:
+ *  LoadOnAnyThread loads run on a pool of loader threads (or the main thread, when it has nothing else to do),
+ *  LoadOnGLThread loads -- and all loads given just a tag -- run on the main thread.
+ * Loads given just a tag run in the same order as before: after every load with an earlier tag,
+ *  and after the previously added tag-only load with the same tag.
+ *
+ * Loads given LoadOnFirstUse are skipped by call_load_functions() (unless a startup load needs them, or they were prefetched):
+ *
+ * Load< ColorProgram > color_program(LoadOptions{"color program", LoadOnGLThread, {}, LoadOnFirstUse});
+ *
+ * ...they run the first time their value is used (operator->, operator*, or conversion to T const *),
+ *  on the thread that used it, exactly once even if several threads get there together.
+ * prefetch() starts one early; report_unused_loads() lists the loads a session never used.
+ *
+ * Every load is timed (and charged for the bytes it reads and uploads);
+ *  call_load_functions() prints a summary, and write_load_trace() saves a trace for chrome://tracing.
+ *
+ * Loads can name the files they read in LoadOptions::watch; after start_hot_reload(), a change to one of those files
+ *  reruns that load (and the loads that depend on it) and swaps the new values in between frames.
+ * Each swap bumps the Load<>'s 'generation', so code that copied something out of it can notice and copy again.
+ *
  */
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <stdexcept>
+#include <string>
+#include <vector>
 
 enum LoadTag : uint32_t {
 	LoadTagEarly,
@@ -32,49 +64,160 @@ enum LoadTag : uint32_t {
 	MaxLoadTag //<-- just used to track # of load tags
 };
 
+enum LoadThread : uint32_t {
+	LoadOnGLThread, //needs the OpenGL context (so runs on the main thread)
+	LoadOnAnyThread, //CPU-only; may run on a loader thread
+};
+
+enum LoadWhen : uint32_t {
+	LoadAtStartup, //run by call_load_functions()
+	LoadOnFirstUse, //run when first used (or when a startup load needs it)
+};
+
+//every Load<> is a LoadBase, so loads can name each other as dependencies:
+struct LoadBase {
+	//make sure this load has finished, running it (and anything it needs) on this thread if nobody has started it:
+	// (throws if it failed, or if it needs the GL thread and this isn't the GL thread)
+	void require() const;
+
+	//hint that a LoadOnFirstUse load will be used soon:
+	// before call_load_functions(), this makes it load at startup;
+	// after, a LoadOnAnyThread load starts on a background thread and a LoadOnGLThread load runs right away (if called on the GL thread)
+	// (failures are kept and thrown at first use)
+	void prefetch() const;
+
+	//require() the first time the value is used:
+	void use() const {
+		if (!used.load(std::memory_order_acquire)) {
+			require();
+			used.store(true, std::memory_order_release);
+		}
+	}
+
+	uint32_t load_index = -1U; //(position in the list of loads; set by add_load_function())
+	mutable std::atomic< bool > used{false}; //(for report_unused_loads())
+	uint32_t generation = 0; //number of times hot reload has swapped in a new value (only changes in update_hot_reload())
+};
+
+struct LoadOptions {
+	std::string name; //shown in error messages
+	LoadThread thread = LoadOnGLThread;
+	std::vector< LoadBase const * > after; //loads that must finish first
+	LoadWhen when = LoadAtStartup;
+	std::vector< std::string > watch; //files this load reads (for hot reload)
+};
+
 //Add a function to an internal list of loading functions:
 // (only call *before* "call_load_functions()")
-void add_load_function(LoadTag tag, std::function< void() > const &fn);
+// ('owner' is the Load<> being loaded, if any, so that other loads can depend on it)
+void add_load_function(LoadTag tag, std::function< void() > const &fn, LoadBase *owner = nullptr);
+// ...or with explicit dependencies ('owner' is the Load<> being loaded, so that other loads can depend on it):
+void add_load_function(LoadBase *owner, LoadOptions const &options, std::function< void() > const &fn);
+
+//Set how hot reload reruns a load:
+// 'reload' should build a new value without changing anything in use, and return a function that swaps it in
+// (Load<> sets this up itself; a load without one is never reloaded)
+void set_reload_function(LoadBase *owner, std::function< std::function< void() >() > const &reload);
 
 //Call all loading functions:
-// (loading functions may throw exceptions if they fail.)
+// (loading functions may throw exceptions if they fail; once every load that can run has finished,
+//  this throws a std::runtime_error listing each failure and the loads that were skipped because of it)
 // (only call *once*)
 void call_load_functions();
 
+//Counters for the load running on this thread (they do nothing outside of load functions):
+// (call them where data is read from files or uploaded to GL, so the load that caused it is charged)
+void count_load_read(size_t bytes);
+void count_load_upload(size_t bytes);
+
+//Print wall/cpu time and bytes read and uploaded for every load that has run, slowest first:
+// (along with how much the process's peak resident memory has grown since call_load_functions() started)
+// (call_load_functions() prints this when it finishes)
+void report_load_stats();
+
+//Write the same statistics as a Chrome trace (chrome://tracing or ui.perfetto.dev), one event per load:
+// (timestamps count from when call_load_functions() started)
+void write_load_trace(std::string const &filename);
+
+//Hot reload:
+// start_hot_reload() starts watching the files named in LoadOptions::watch (inotify on Linux; polling elsewhere);
+// update_hot_reload() -- call it between frames, on the GL thread -- reruns loads whose files changed
+//  (LoadOnAnyThread loads on a background thread), swaps in their new values, then does the same for the loads that depend on them.
+// (if a reload fails, the old value is kept; old values are never freed, since code may still point into them)
+void start_hot_reload();
+void update_hot_reload();
+
+//Print the loads that were never used this session:
+// (either loaded at startup for nothing -- good LoadOnFirstUse candidates -- or never loaded at all)
+void report_unused_loads();
+
 
 //work-around for MSVC not accepting this as a lambda:
 template< typename T >
 T const *new_T() { return new T; }
 
 template< typename T >
-struct Load {
+struct Load : LoadBase {
 	//Constructing a Load< T > adds the passed function to the list of functions to call:
 	Load(LoadTag tag, const std::function< T const *() > &load_fn = new_T< T >) : value(nullptr) {
 		add_load_function(tag, [this,load_fn](){
-			this->value = load_fn();
-			if (!(this->value)) {
-				throw std::runtime_error("Loading failed.");
-			}
+			this->value = checked(load_fn);
+		}, this);
+		set_reloadable(load_fn);
+	}
+	Load(LoadOptions const &options, const std::function< T const *() > &load_fn = new_T< T >) : value(nullptr) {
+		add_load_function(this, options, [this,load_fn](){
+			this->value = checked(load_fn);
 		});
+		set_reloadable(load_fn);
 	}
 
 	//Make a "Load< T >" behave like a "T const *":
-	explicit operator bool() { return value != nullptr; }
-	operator T const *() { return value; }
-	T const &operator*() { return *value; }
-	T const *operator->() { return value; }
+	// (using the value runs a LoadOnFirstUse load, if it hasn't run yet)
+	explicit operator bool() { return value != nullptr; } //(only checks if loaded; doesn't run the load)
+	operator T const *() { use(); return value; }
+	T const &operator*() { use(); return *value; }
+	T const *operator->() { use(); return value; }
 
 	T const *value;
+
+	//--- internals ---
+	static T const *checked(const std::function< T const *() > &load_fn) {
+		T const *ret = load_fn();
+		if (!ret) {
+			throw std::runtime_error("Loading failed.");
+		}
+		return ret;
+	}
+	void set_reloadable(const std::function< T const *() > &load_fn) {
+		set_reload_function(this, [this,load_fn]() -> std::function< void() > {
+			T const *fresh = checked(load_fn);
+			return [this,fresh](){ this->value = fresh; };
+		});
+	}
 };
 
 
 //Specialization:
 //Load< void > just calls a function:
 template< >
-struct Load< void > {
+struct Load< void > : LoadBase {
 	//Constructing a Load< T > adds the passed function to the list of functions to call:
+	// (running it counts as using it; call require() to run a LoadOnFirstUse one)
 	Load( LoadTag tag, const std::function< void() > &load_fn) {
-		add_load_function(tag, load_fn);
+		add_load_function(tag, [this,load_fn](){
+			load_fn();
+			used.store(true);
+		}, this);
+	}
+	//A Load< void > changes state that is already in use, so hot reload can't just run 'load_fn' again;
+	// it is only reloaded if given 'reload', which works like set_reload_function()'s (build, then return the swap):
+	Load( LoadOptions const &options, const std::function< void() > &load_fn, const std::function< std::function< void() >() > &reload = nullptr) {
+		add_load_function(this, options, [this,load_fn](){
+			load_fn();
+			used.store(true);
+		});
+		if (reload) set_reload_function(this, reload);
 	}
 };
 
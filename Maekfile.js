@@ -30,6 +30,7 @@ if (maek.OS === "windows") {
 		`/I${NEST_LIBS}/SDL2/include`,
 		`/I${NEST_LIBS}/glm/include`,
 		`/I${NEST_LIBS}/libpng/include`,
+		`/I${NEST_LIBS}/zlib/include`,
 		`/I${NEST_LIBS}/opusfile/include`,
 		`/I${NEST_LIBS}/libopus/include`,
 		`/I${NEST_LIBS}/libogg/include`,
@@ -56,6 +57,7 @@ if (maek.OS === "windows") {
 		`-I${NEST_LIBS}/SDL2/include/SDL2`, `-D_THREAD_SAFE`, //the output of sdl-config --cflags
 		`-I${NEST_LIBS}/glm/include`,
 		`-I${NEST_LIBS}/libpng/include`,
+		`-I${NEST_LIBS}/zlib/include`,
 		`-I${NEST_LIBS}/opusfile/include`,
 		`-I${NEST_LIBS}/libopus/include`,
 		`-I${NEST_LIBS}/libogg/include`
@@ -76,6 +78,7 @@ if (maek.OS === "windows") {
 		`-I${NEST_LIBS}/SDL2/include/SDL2`, `-D_THREAD_SAFE`, //the output of sdl-config --cflags
 		`-I${NEST_LIBS}/glm/include`,
 		`-I${NEST_LIBS}/libpng/include`,
+		`-I${NEST_LIBS}/zlib/include`,
 		`-I${NEST_LIBS}/opusfile/include`,
 		`-I${NEST_LIBS}/libopus/include`,
 		`-I${NEST_LIBS}/libogg/include`
@@ -141,9 +144,14 @@ const common_names = [
 	maek.CPP('Mesh.cpp'),
 	maek.CPP('load_save_png.cpp'),
 	maek.CPP('gl_compile_program.cpp'),
+	maek.CPP('gl_state.cpp'),
 	maek.CPP('Mode.cpp'),
 	maek.CPP('GL.cpp'),
-	maek.CPP('Load.cpp')
+	maek.CPP('Load.cpp'),
+	maek.CPP('WorkerPool.cpp'),
+	maek.CPP('MappedFile.cpp'),
+	maek.CPP('DataFile.cpp'),
+	maek.CPP('read_write_chunk.cpp')
 ];
 
 const show_meshes_names = [
@@ -162,6 +170,18 @@ const load_rhythm_names = [
 	maek.CPP('load_txt.cpp')
 ];
 
+const bench_scene_names = [
+	maek.CPP('bench-scene.cpp')
+];
+
+const index_meshes_names = [
+	maek.CPP('index-meshes.cpp')
+];
+
+const pack_assets_names = [
+	maek.CPP('pack-assets.cpp')
+];
+
 //the '[exeFile =] LINK(objFiles, exeFileBase, [, options])' links an array of objects into an executable:
 // objFiles: array of objects to link
 // exeFileBase: name of executable file to produce
@@ -170,9 +190,30 @@ const game_exe = maek.LINK([...game_names, ...common_names], 'dist/game');
 const show_meshes_exe = maek.LINK([...show_meshes_names, ...common_names], 'scenes/show-meshes');
 const show_scene_exe = maek.LINK([...show_scene_names, ...common_names], 'scenes/show-scene');
 const load_rhythm_exe = maek.LINK([...load_rhythm_names, ...common_names], 'assets/load-rhythm');
+const bench_scene_exe = maek.LINK([...bench_scene_names, ...common_names], 'scenes/bench-scene');
+const index_meshes_exe = maek.LINK([...index_meshes_names, ...common_names], 'scenes/index-meshes');
+const pack_assets_exe = maek.LINK([...pack_assets_names, ...common_names], 'assets/pack-assets');
+
+//bundle the game's data files into dist/data.pack, which the game reads instead of the loose files when it exists:
+// (these are written by the exporters in scenes/ and by assets/load-rhythm, outside of this build, so list new ones here)
+const packed_assets = [
+	'dist/rhythm.chunk',
+	'dist/snake-bop.wav',
+	'dist/snake.pnct',
+	'dist/snake.scene'
+];
+//NOTE: the sample (and its source) aren't in the repository, and nothing here can make it -- copy snake-bop.wav into dist/ by hand.
+// The game can't start without it, so it is always packed when present; until then, the pack is built without it
+// (and the missing file is reported when the game loads it, rather than failing the whole build):
+if (!require('fs').existsSync('dist/snake-bop.wav')) {
+	packed_assets.splice(packed_assets.indexOf('dist/snake-bop.wav'), 1);
+}
+maek.RULE(['dist/data.pack'], [pack_assets_exe, ...packed_assets], [
+	[pack_assets_exe, 'dist/data.pack', ...packed_assets]
+]);
 
-//set the default target to the game (and copy the readme files):
-maek.TARGETS = [game_exe, show_meshes_exe, show_scene_exe, load_rhythm_exe, ...copies];
+//set the default target to the game (and copy the readme files, and pack the data files):
+maek.TARGETS = [game_exe, show_meshes_exe, show_scene_exe, load_rhythm_exe, bench_scene_exe, index_meshes_exe, pack_assets_exe, 'dist/data.pack', ...copies];
 
 //the '[targets =] RULE(targets, prerequisites[, recipe])' rule defines a Makefile-style task
 // targets: array of targets the task produces (can include both files and ':abstract targets')
@@ -183,6 +224,11 @@ maek.RULE([':run'], [game_exe], [
 	[game_exe, '--some-command-line-option']
 ]);
 
+//'node Maekfile.js :bench' runs the scene benchmarks:
+maek.RULE([':bench'], [bench_scene_exe], [
+	[bench_scene_exe]
+]);
+
 //Note that tasks that produce ':abstract targets' are never cached.
 // This is similar to how .PHONY targets behave in make.
 
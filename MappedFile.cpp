@@ -0,0 +1,100 @@
+#include "MappedFile.hpp"
+#include "Load.hpp"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(std::string const &filename_) : filename(filename_) {
+	file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = nullptr;
+		throw std::runtime_error("Failed to open '" + filename + "' for mapping.");
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		CloseHandle(file);
+		throw std::runtime_error("Failed to get size of '" + filename + "'.");
+	}
+	length = size_t(file_size.QuadPart);
+	if (length == 0) return; //(can't map an empty file; leave begin == nullptr)
+
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL) {
+		mapping = nullptr;
+		CloseHandle(file);
+		throw std::runtime_error("Failed to create mapping for '" + filename + "'.");
+	}
+	begin = reinterpret_cast< char const * >(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (begin == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		throw std::runtime_error("Failed to map view of '" + filename + "'.");
+	}
+	count_load_read(length); //(charged in full, though pages are only read as they are touched)
+}
+
+void MappedFile::prefetch() const {
+	if (!begin) return;
+#if _WIN32_WINNT >= 0x0602 //(PrefetchVirtualMemory is Windows 8+)
+	WIN32_MEMORY_RANGE_ENTRY range;
+	range.VirtualAddress = const_cast< char * >(begin);
+	range.NumberOfBytes = length;
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+}
+
+MappedFile::~MappedFile() {
+	if (begin) UnmapViewOfFile(begin);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+}
+
+#else
+
+MappedFile::MappedFile(std::string const &filename_) : filename(filename_) {
+	int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Failed to open '" + filename + "' for mapping.");
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		throw std::runtime_error("Failed to get size of '" + filename + "'.");
+	}
+	length = size_t(st.st_size);
+	if (length == 0) { //(can't map an empty file; leave begin == nullptr)
+		close(fd);
+		return;
+	}
+
+	void *mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd); //(the mapping keeps the file open)
+	if (mapped == MAP_FAILED) {
+		throw std::runtime_error("Failed to map '" + filename + "'.");
+	}
+	begin = reinterpret_cast< char const * >(mapped);
+	count_load_read(length); //(charged in full, though pages are only read as they are touched)
+}
+
+void MappedFile::prefetch() const {
+	if (!begin) return;
+	posix_madvise(const_cast< char * >(begin), length, POSIX_MADV_WILLNEED);
+}
+
+MappedFile::~MappedFile() {
+	if (begin) munmap(const_cast< char * >(begin), length);
+}
+
+#endif
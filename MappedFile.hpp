@@ -0,0 +1,40 @@
+#pragma once
+
+/*
+ * A MappedFile maps a whole file, read-only, into memory
+ *  (mmap on Linux/macOS, MapViewOfFile on Windows).
+ *
+ * Pages are read from disk as they are touched and are backed by the OS file cache,
+ *  so nothing is copied into process-owned memory until you copy it yourself.
+ * (see ChunkReader in read_write_chunk.hpp for handing out views of chunks in a mapping)
+ */
+
+#include <cstddef>
+#include <string>
+
+struct MappedFile {
+	//map 'filename':
+	// note: will throw if the file can't be opened or mapped.
+	MappedFile(std::string const &filename);
+	~MappedFile();
+
+	MappedFile(MappedFile const &) = delete;
+	MappedFile &operator=(MappedFile const &) = delete;
+
+	char const *data() const { return begin; }
+	size_t size() const { return length; }
+
+	//ask the OS to start reading the whole file now, as one sequential read,
+	// rather than a page at a time as it is touched: (does nothing if the OS can't)
+	void prefetch() const;
+
+	std::string filename; //(for error messages)
+
+	//--- internals ---
+	char const *begin = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void *file = nullptr; //HANDLE
+	void *mapping = nullptr; //HANDLE
+#endif
+};
@@ -1,120 +1,539 @@
 #include "Mesh.hpp"
 #include "read_write_chunk.hpp"
+#include "DataFile.hpp"
+#include "Load.hpp"
+#include "gl_state.hpp"
 
 #include <glm/glm.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <stdexcept>
-#include <fstream>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <set>
 #include <cstddef>
+#include <cassert>
+#include <memory>
+#include <thread>
+#include <type_traits>
 
-MeshBuffer::MeshBuffer(std::string const &filename) {
-	glGenBuffers(1, &buffer);
+//full-precision vertices ("pnct" chunk):
+struct Vertex {
+	glm::vec3 Position;
+	glm::vec3 Normal;
+	glm::u8vec4 Color;
+	glm::vec2 TexCoord;
+};
+static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
 
-	std::ifstream file(filename, std::ios::binary);
+//quantized vertices ("pncq" chunk):
+// Position is unsigned-normalized over the mesh's bounds (from the "bnd0" chunk; see Mesh::dequantize),
+// Normal is GL_INT_2_10_10_10_REV (x in the low bits), and TexCoord is a pair of half floats.
+struct PackedVertex {
+	glm::u16vec4 Position; //(w is padding)
+	uint32_t Normal;
+	glm::u8vec4 Color;
+	glm::u16vec2 TexCoord;
+};
+static_assert(sizeof(PackedVertex) == 4*2+4+4*1+2*2, "PackedVertex is packed.");
 
-	GLuint total = 0;
-
-	struct Vertex {
-		glm::vec3 Position;
-		glm::vec3 Normal;
-		glm::u8vec4 Color;
-		glm::vec2 TexCoord;
-	};
-	static_assert(sizeof(Vertex) == 3*4+3*4+4*1+2*4, "Vertex is packed.");
-	std::vector< Vertex > data;
+//stream vertices to 'buffer' in blocks, growing mesh bounds as each block goes past (for full-precision vertices):
+template< typename V >
+static void upload_vertices(GLuint buffer, ChunkStream< V > &vertices, std::vector< Mesh > &loaded) {
+	//meshes in order of their first vertex, so each block only visits the meshes it overlaps:
+	std::vector< uint32_t > by_start(loaded.size());
+	for (uint32_t i = 0; i < by_start.size(); ++i) by_start[i] = i;
+	std::sort(by_start.begin(), by_start.end(), [&](uint32_t a, uint32_t b) {
+		return loaded[a].start < loaded[b].start;
+	});
+	size_t first_open = 0; //meshes before this end before the current block
 
-	//read + upload data chunk:
-	if (filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct") {
-		read_chunk(file, "pnct", &data);
+	constexpr size_t BlockVertices = 65536; //(~2.25MB of full-precision vertices, only used if blocks need to be copied)
+	std::vector< V > staging(std::min(vertices.size(), BlockVertices));
 
-		//upload data:
-		glBindBuffer(GL_ARRAY_BUFFER, buffer);
-		glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(Vertex), data.data(), GL_STATIC_DRAW);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	gl_state.bind_buffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vertices.size()) * sizeof(V), nullptr, GL_STATIC_DRAW);
 
-		total = GLuint(data.size()); //store total for later checks on index
+	V const *block = nullptr;
+	GLuint block_begin = 0;
+	while (size_t count = vertices.next(staging.data(), staging.size(), &block)) {
+		GLuint block_end = block_begin + GLuint(count);
+		glBufferSubData(GL_ARRAY_BUFFER, GLintptr(block_begin) * sizeof(V), GLsizeiptr(count) * sizeof(V), block);
+		count_load_upload(count * sizeof(V));
 
-		//store attrib locations:
-		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
-		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
-		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Color));
-		TexCoord = Attrib(2, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, TexCoord));
-	} else {
-		throw std::runtime_error("Unknown file type '" + filename + "'");
+		if constexpr (std::is_same< V, Vertex >::value) {
+			while (first_open < by_start.size() && loaded[by_start[first_open]].start + loaded[by_start[first_open]].count <= block_begin) {
+				++first_open;
+			}
+			for (size_t o = first_open; o < by_start.size() && loaded[by_start[o]].start < block_end; ++o) {
+				Mesh &mesh = loaded[by_start[o]];
+				GLuint begin = std::max(mesh.start, block_begin);
+				GLuint end = std::min(mesh.start + mesh.count, block_end);
+				for (GLuint v = begin; v < end; ++v) {
+					mesh.min = glm::min(mesh.min, block[v - block_begin].Position);
+					mesh.max = glm::max(mesh.max, block[v - block_begin].Position);
+				}
+			}
+		}
+		block_begin = block_end;
 	}
+	gl_state.bind_buffer(GL_ARRAY_BUFFER, 0);
+}
+
+//mesh ranges and names from a file's index chunk, checked against its 'total' vertices:
+// (bounds are filled in from "bnd0" for quantized files, and left for the caller to gather otherwise)
+struct MeshIndex {
+	std::vector< Mesh > meshes;
+	std::vector< std::string_view > names; //(point into 'strings')
+	ChunkView< char > strings;
+	ChunkView< uint16_t > elements16;
+	ChunkView< uint32_t > elements32;
+	GLenum index_type = GL_UNSIGNED_INT;
+	size_t element_count = 0;
+};
+
+static void read_index(ChunkReader const &reader, GLuint total, bool quantized, MeshIndex *index_) {
+	assert(index_);
+	MeshIndex &index = *index_;
 
-	std::vector< char > strings;
-	read_chunk(file, "str0", &strings);
+	index.strings = reader.find< char >("str0");
 
-	{ //read index chunk, add to meshes:
-		struct IndexEntry {
+	//read index chunk -- "idx0" (vertex ranges) or, for indexed files, "idx1" (vertex ranges + ranges in an element chunk):
+	struct IndexEntry {
+		uint32_t name_begin, name_end;
+		uint32_t vertex_begin, vertex_end;
+		uint32_t index_begin = 0, index_end = 0; //(only stored in idx1)
+	};
+	static_assert(sizeof(IndexEntry) == 24, "Index entry should be packed");
+
+	std::vector< IndexEntry > entries;
+	if (reader.lookup("idx1")) {
+		ChunkView< IndexEntry > chunk = reader.find< IndexEntry >("idx1");
+		entries.assign(chunk.begin(), chunk.end());
+		//indices are mesh-relative (drawn with mesh.start as the base vertex) and either 16 or 32 bits:
+		if (reader.lookup("el16")) {
+			index.elements16 = reader.find< uint16_t >("el16");
+			index.element_count = index.elements16.size();
+			index.index_type = GL_UNSIGNED_SHORT;
+		} else {
+			index.elements32 = reader.find< uint32_t >("el32");
+			index.element_count = index.elements32.size();
+			index.index_type = GL_UNSIGNED_INT;
+		}
+	} else {
+		struct IndexEntry0 {
 			uint32_t name_begin, name_end;
 			uint32_t vertex_begin, vertex_end;
 		};
-		static_assert(sizeof(IndexEntry) == 16, "Index entry should be packed");
-
-		std::vector< IndexEntry > index;
-		read_chunk(file, "idx0", &index);
+		static_assert(sizeof(IndexEntry0) == 16, "Index entry should be packed");
+		ChunkView< IndexEntry0 > chunk = reader.find< IndexEntry0 >("idx0");
+		entries.reserve(chunk.size());
+		for (auto const &entry : chunk) {
+			entries.emplace_back(IndexEntry{entry.name_begin, entry.name_end, entry.vertex_begin, entry.vertex_end});
+		}
+	}
 
-		for (auto const &entry : index) {
-			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
-				throw std::runtime_error("index entry has out-of-range name begin/end");
-			}
-			if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= total)) {
-				throw std::runtime_error("index entry has out-of-range vertex start/count");
-			}
-			std::string name(&strings[0] + entry.name_begin, &strings[0] + entry.name_end);
-			Mesh mesh;
-			mesh.type = GL_TRIANGLES;
-			mesh.start = entry.vertex_begin;
-			mesh.count = entry.vertex_end - entry.vertex_begin;
-			for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
-				mesh.min = glm::min(mesh.min, data[v].Position);
-				mesh.max = glm::max(mesh.max, data[v].Position);
-			}
-			bool inserted = meshes.insert(std::make_pair(name, mesh)).second;
-			if (!inserted) {
-				std::cerr << "WARNING: mesh name '" + name + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
+	index.meshes.resize(entries.size());
+	index.names.reserve(entries.size());
+	for (uint32_t i = 0; i < entries.size(); ++i) {
+		IndexEntry const &entry = entries[i];
+		if (!(entry.name_begin <= entry.name_end && entry.name_end <= index.strings.size())) {
+			throw std::runtime_error("index entry has out-of-range name begin/end");
+		}
+		if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= total)) {
+			throw std::runtime_error("index entry has out-of-range vertex start/count");
+		}
+		if (!(entry.index_begin <= entry.index_end && entry.index_end <= index.element_count)) {
+			throw std::runtime_error("index entry has out-of-range index start/count");
+		}
+		//indices must stay inside the mesh's own vertices:
+		uint32_t vertex_count = entry.vertex_end - entry.vertex_begin;
+		for (uint32_t e = entry.index_begin; e < entry.index_end; ++e) {
+			uint32_t element = (index.index_type == GL_UNSIGNED_SHORT ? index.elements16[e] : index.elements32[e]);
+			if (element >= vertex_count) {
+				throw std::runtime_error("index entry has out-of-range vertex index");
 			}
 		}
+		Mesh &mesh = index.meshes[i];
+		mesh.type = GL_TRIANGLES;
+		mesh.start = entry.vertex_begin;
+		mesh.count = vertex_count;
+		mesh.index_type = index.index_type;
+		mesh.index_start = entry.index_begin;
+		mesh.index_count = entry.index_end - entry.index_begin;
+		index.names.emplace_back(index.strings.data() + entry.name_begin, entry.name_end - entry.name_begin);
 	}
 
-	if (file.peek() != EOF) {
+	if (quantized) {
+		//quantized positions are stored relative to each mesh's bounds:
+		struct Bounds {
+			glm::vec3 min, max;
+		};
+		static_assert(sizeof(Bounds) == 4*3*2, "Bounds are packed.");
+		ChunkView< Bounds > bounds = reader.find< Bounds >("bnd0");
+		if (bounds.size() != index.meshes.size()) {
+			throw std::runtime_error("bounds chunk doesn't match index chunk");
+		}
+		for (uint32_t i = 0; i < index.meshes.size(); ++i) {
+			Mesh &mesh = index.meshes[i];
+			mesh.min = bounds[i].min;
+			mesh.max = bounds[i].max;
+			glm::vec3 extent = mesh.max - mesh.min;
+			mesh.dequantize = glm::mat4x3(
+				glm::vec3(extent.x, 0.0f, 0.0f),
+				glm::vec3(0.0f, extent.y, 0.0f),
+				glm::vec3(0.0f, 0.0f, extent.z),
+				mesh.min
+			);
+		}
+	}
+}
+
+//state for a MeshBuffer that is decoded on a background thread and uploaded a slice at a time:
+struct MeshBuffer::Pending {
+	std::string filename;
+	std::unique_ptr< DataFile > file;
+	std::unique_ptr< ChunkReader > reader;
+	bool quantized = false;
+
+	//written by the decode thread, then read on the main thread once 'decoded' is set:
+	std::thread thread;
+	std::atomic< bool > decoded{false};
+	std::exception_ptr error;
+	MeshIndex index;
+	ChunkView< Vertex > vertices;
+	ChunkView< PackedVertex > packed_vertices;
+
+	//upload progress (main thread only):
+	bool allocated = false;
+	size_t vertex_bytes_uploaded = 0;
+	size_t index_bytes_uploaded = 0;
+
+	std::vector< std::function< void() > > on_ready;
+};
+
+//every MeshBuffer still being decoded or uploaded, in construction order:
+static std::vector< MeshBuffer * > &get_pending_buffers() {
+	static std::vector< MeshBuffer * > pending_buffers;
+	return pending_buffers;
+}
+
+MeshBuffer::MeshBuffer(std::string const &filename) {
+	glGenBuffers(1, &buffer);
+
+	//chunks are used in place from the mapping (or pack), so vertex data goes straight from the file to GL:
+	DataFile file(filename);
+	ChunkReader reader(file.data(), file.data() + file.size());
+
+	if (!(filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct")) {
+		throw std::runtime_error("Unknown file type '" + filename + "'");
+	}
+
+	//vertices are streamed to GL in blocks (after reading the index, so mesh bounds can be gathered on the way):
+	// (quantized files have "pncq" vertices instead of "pnct")
+	std::unique_ptr< ChunkStream< Vertex > > vertices;
+	std::unique_ptr< ChunkStream< PackedVertex > > packed_vertices;
+	GLuint total = 0; //store total for later checks on index
+
+	bool quantized = (reader.lookup("pncq") != nullptr);
+	set_attribs(quantized);
+	if (quantized) {
+		packed_vertices.reset(new ChunkStream< PackedVertex >(reader, "pncq"));
+		total = GLuint(packed_vertices->size());
+	} else {
+		vertices.reset(new ChunkStream< Vertex >(reader, "pnct"));
+		total = GLuint(vertices->size());
+	}
+
+	MeshIndex index;
+	read_index(reader, total, quantized, &index);
+	index_type = index.index_type;
+
+	if (index.element_count) { //upload indices:
+		// (through GL_COPY_WRITE_BUFFER, since the GL_ELEMENT_ARRAY_BUFFER binding belongs to whichever vertex array is bound)
+		glGenBuffers(1, &index_buffer);
+		gl_state.bind_buffer(GL_COPY_WRITE_BUFFER, index_buffer);
+		if (index_type == GL_UNSIGNED_SHORT) {
+			glBufferData(GL_COPY_WRITE_BUFFER, index.elements16.size() * sizeof(uint16_t), index.elements16.data(), GL_STATIC_DRAW);
+			count_load_upload(index.elements16.size() * sizeof(uint16_t));
+		} else {
+			glBufferData(GL_COPY_WRITE_BUFFER, index.elements32.size() * sizeof(uint32_t), index.elements32.data(), GL_STATIC_DRAW);
+			count_load_upload(index.elements32.size() * sizeof(uint32_t));
+		}
+		gl_state.bind_buffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	//upload vertex data:
+	if (packed_vertices) upload_vertices(buffer, *packed_vertices, index.meshes);
+	else upload_vertices(buffer, *vertices, index.meshes);
+
+	add_meshes(filename, index.meshes, index.names);
+
+	if (reader.trailing() != 0) {
 		std::cerr << "WARNING: trailing data in mesh file '" << filename << "'" << std::endl;
 	}
 
 	/* //DEBUG:
 	std::cout << "File '" << filename << "' contained meshes";
-	for (auto const &m : meshes) {
-		if (&m.second == &meshes.rbegin()->second && meshes.size() > 1) std::cout << " and";
-		std::cout << " '" << m.first << "'";
-		if (&m.second != &meshes.rbegin()->second) std::cout << ",";
+	for (uint32_t id = 0; id < mesh_names.size(); ++id) {
+		if (id + 1 == mesh_names.size() && mesh_names.size() > 1) std::cout << " and";
+		std::cout << " '" << mesh_names[id] << "'";
+		if (id + 1 != mesh_names.size()) std::cout << ",";
 	}
 	std::cout << std::endl;
 	*/
 }
 
+MeshBuffer::MeshBuffer(std::string const &filename, Background) : pending(new Pending) {
+	if (!(filename.size() >= 5 && filename.substr(filename.size()-5) == ".pnct")) {
+		throw std::runtime_error("Unknown file type '" + filename + "'");
+	}
+
+	//the table of contents is enough to know the vertex format and whether there are indices, so vaos can be made right away:
+	pending->filename = filename;
+	pending->file.reset(new DataFile(filename));
+	pending->reader.reset(new ChunkReader(pending->file->data(), pending->file->data() + pending->file->size()));
+	pending->quantized = (pending->reader->lookup("pncq") != nullptr);
+	set_attribs(pending->quantized);
+
+	glGenBuffers(1, &buffer);
+	if (pending->reader->lookup("idx1")) {
+		glGenBuffers(1, &index_buffer);
+		index_type = (pending->reader->lookup("el16") ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+	}
+
+	//decompress, check the index, and gather bounds on a background thread (no GL calls there):
+	Pending *state = pending.get();
+	pending->thread = std::thread([state](){
+		try {
+			ChunkReader const &reader = *state->reader;
+			GLuint total = 0;
+			if (state->quantized) {
+				state->packed_vertices = reader.find< PackedVertex >("pncq");
+				total = GLuint(state->packed_vertices.size());
+			} else {
+				state->vertices = reader.find< Vertex >("pnct");
+				total = GLuint(state->vertices.size());
+			}
+			read_index(reader, total, state->quantized, &state->index);
+			if (!state->quantized) {
+				for (Mesh &mesh : state->index.meshes) {
+					for (GLuint v = mesh.start; v < mesh.start + mesh.count; ++v) {
+						mesh.min = glm::min(mesh.min, state->vertices[v].Position);
+						mesh.max = glm::max(mesh.max, state->vertices[v].Position);
+					}
+				}
+			}
+		} catch (...) {
+			state->error = std::current_exception();
+		}
+		state->decoded = true;
+	});
+
+	get_pending_buffers().emplace_back(this);
+}
+
+MeshBuffer::~MeshBuffer() {
+	if (pending) {
+		if (pending->thread.joinable()) pending->thread.join();
+		auto &pending_buffers = get_pending_buffers();
+		pending_buffers.erase(std::remove(pending_buffers.begin(), pending_buffers.end(), this), pending_buffers.end());
+	}
+}
+
+void MeshBuffer::on_ready(std::function< void() > const &fn) const {
+	if (pending) pending->on_ready.emplace_back(fn);
+	else fn();
+}
+
+void MeshBuffer::upload_pending(size_t byte_budget) {
+	auto &pending_buffers = get_pending_buffers();
+	for (size_t i = 0; i < pending_buffers.size(); ) {
+		MeshBuffer &mb = *pending_buffers[i];
+		Pending &state = *mb.pending;
+		if (!state.decoded) {
+			++i;
+			continue;
+		}
+		if (state.error) {
+			//record decode failures on the buffer (see failed()) and let its on_ready functions know:
+			state.thread.join();
+			try {
+				std::rethrow_exception(state.error);
+			} catch (std::exception const &e) {
+				mb.error = e.what();
+			} catch (...) {
+				mb.error = "unknown exception";
+			}
+			std::cerr << "ERROR: loading mesh file '" << state.filename << "' failed: " << mb.error << std::endl;
+			std::vector< std::function< void() > > on_ready = std::move(state.on_ready);
+			pending_buffers.erase(pending_buffers.begin() + i);
+			mb.pending.reset();
+			for (auto const &fn : on_ready) {
+				fn();
+			}
+			continue;
+		}
+
+		char const *vertex_data = (state.quantized ? reinterpret_cast< char const * >(state.packed_vertices.data()) : reinterpret_cast< char const * >(state.vertices.data()));
+		size_t vertex_bytes = (state.quantized ? state.packed_vertices.size() * sizeof(PackedVertex) : state.vertices.size() * sizeof(Vertex));
+		char const *index_data = (mb.index_type == GL_UNSIGNED_SHORT ? reinterpret_cast< char const * >(state.index.elements16.data()) : reinterpret_cast< char const * >(state.index.elements32.data()));
+		size_t index_bytes = state.index.element_count * (mb.index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t));
+
+		if (!state.allocated) {
+			gl_state.bind_buffer(GL_ARRAY_BUFFER, mb.buffer);
+			glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vertex_bytes), nullptr, GL_STATIC_DRAW);
+			gl_state.bind_buffer(GL_ARRAY_BUFFER, 0);
+			if (mb.index_buffer) {
+				gl_state.bind_buffer(GL_COPY_WRITE_BUFFER, mb.index_buffer);
+				glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(index_bytes), nullptr, GL_STATIC_DRAW);
+				gl_state.bind_buffer(GL_COPY_WRITE_BUFFER, 0);
+			}
+			state.allocated = true;
+		}
+
+		//upload the next slices of vertex, then index, data:
+		if (state.vertex_bytes_uploaded < vertex_bytes && byte_budget > 0) {
+			size_t bytes = std::min(byte_budget, vertex_bytes - state.vertex_bytes_uploaded);
+			gl_state.bind_buffer(GL_ARRAY_BUFFER, mb.buffer);
+			glBufferSubData(GL_ARRAY_BUFFER, GLintptr(state.vertex_bytes_uploaded), GLsizeiptr(bytes), vertex_data + state.vertex_bytes_uploaded);
+			gl_state.bind_buffer(GL_ARRAY_BUFFER, 0);
+			count_load_upload(bytes);
+			state.vertex_bytes_uploaded += bytes;
+			byte_budget -= bytes;
+		}
+		if (state.index_bytes_uploaded < index_bytes && byte_budget > 0) {
+			size_t bytes = std::min(byte_budget, index_bytes - state.index_bytes_uploaded);
+			gl_state.bind_buffer(GL_COPY_WRITE_BUFFER, mb.index_buffer);
+			glBufferSubData(GL_COPY_WRITE_BUFFER, GLintptr(state.index_bytes_uploaded), GLsizeiptr(bytes), index_data + state.index_bytes_uploaded);
+			gl_state.bind_buffer(GL_COPY_WRITE_BUFFER, 0);
+			count_load_upload(bytes);
+			state.index_bytes_uploaded += bytes;
+			byte_budget -= bytes;
+		}
+		if (state.vertex_bytes_uploaded < vertex_bytes || state.index_bytes_uploaded < index_bytes) {
+			break; //(out of budget for this frame)
+		}
+
+		//everything is on the GPU; publish the meshes and let go of the file:
+		state.thread.join();
+		mb.add_meshes(state.filename, state.index.meshes, state.index.names);
+		if (state.reader->trailing() != 0) {
+			std::cerr << "WARNING: trailing data in mesh file '" << state.filename << "'" << std::endl;
+		}
+		std::vector< std::function< void() > > on_ready = std::move(state.on_ready);
+		pending_buffers.erase(pending_buffers.begin() + i);
+		mb.pending.reset();
+		for (auto const &fn : on_ready) {
+			fn();
+		}
+	}
+}
+
+void MeshBuffer::set_attribs(bool quantized) {
+	//store attrib locations:
+	if (quantized) {
+		Position = Attrib(3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedVertex), offsetof(PackedVertex, Position));
+		Normal = Attrib(4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), offsetof(PackedVertex, Normal));
+		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PackedVertex), offsetof(PackedVertex, Color));
+		TexCoord = Attrib(2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), offsetof(PackedVertex, TexCoord));
+	} else {
+		Position = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Position));
+		Normal = Attrib(3, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, Normal));
+		Color = Attrib(4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), offsetof(Vertex, Color));
+		TexCoord = Attrib(2, GL_FLOAT, GL_FALSE, sizeof(Vertex), offsetof(Vertex, TexCoord));
+	}
+}
+
+void MeshBuffer::add_meshes(std::string const &filename, std::vector< Mesh > const &loaded, std::vector< std::string_view > const &names) {
+	assert(loaded.size() == names.size());
+
+	//add to meshes (IDs are assigned in file order) and build the name index:
+	{
+		size_t bucket_count = 2;
+		while (bucket_count < 2 * loaded.size()) bucket_count *= 2;
+		index_buckets.assign(bucket_count, -1U);
+		meshes.reserve(loaded.size());
+		mesh_names.reserve(loaded.size());
+		name_hashes.reserve(loaded.size());
+	}
+	for (uint32_t i = 0; i < loaded.size(); ++i) {
+		std::string_view name = names[i];
+		uint64_t hash = hash_name(name);
+		size_t mask = index_buckets.size() - 1;
+		size_t b = size_t(hash) & mask;
+		while (index_buckets[b] != -1U && !(name_hashes[index_buckets[b]] == hash && mesh_names[index_buckets[b]] == name)) {
+			b = (b + 1) & mask;
+		}
+		if (index_buckets[b] != -1U) {
+			std::cerr << "WARNING: mesh name '" + std::string(name) + "' in filename '" + filename + "' collides with existing mesh." << std::endl;
+			continue;
+		}
+		index_buckets[b] = uint32_t(meshes.size());
+		meshes.emplace_back(loaded[i]);
+		mesh_names.emplace_back(name);
+		name_hashes.emplace_back(hash);
+	}
+}
+
 const Mesh &MeshBuffer::lookup(std::string const &name) const {
-	auto f = meshes.find(name);
-	if (f == meshes.end()) {
+	uint32_t id = find_id(name);
+	if (id == -1U) {
 		throw std::runtime_error("Looking up mesh '" + name + "' that doesn't exist.");
 	}
-	return f->second;
+	return meshes[id];
+}
+
+uint64_t MeshBuffer::hash_name(std::string_view name) {
+	//64-bit FNV-1a:
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (char c : name) {
+		hash ^= uint8_t(c);
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+uint32_t MeshBuffer::find_id(std::string_view name) const {
+	if (index_buckets.empty()) return -1U;
+	uint64_t hash = hash_name(name);
+	size_t mask = index_buckets.size() - 1;
+	//(the index is at most half full, so probing always reaches an empty bucket)
+	for (size_t b = size_t(hash) & mask; index_buckets[b] != -1U; b = (b + 1) & mask) {
+		uint32_t id = index_buckets[b];
+		if (name_hashes[id] == hash && mesh_names[id] == name) return id;
+	}
+	return -1U;
+}
+
+void MeshBuffer::resolve(std::vector< std::string_view > const &names, std::vector< uint32_t > *ids_) const {
+	assert(ids_);
+	auto &ids = *ids_;
+	ids.resize(names.size());
+	for (size_t i = 0; i < names.size(); ++i) {
+		ids[i] = find_id(names[i]);
+	}
+}
+
+const Mesh &MeshBuffer::get(uint32_t id) const {
+	if (id >= meshes.size()) {
+		throw std::runtime_error("Looking up mesh id " + std::to_string(id) + " that doesn't exist.");
+	}
+	return meshes[id];
 }
 
-GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
+GLuint MeshBuffer::make_vao_for_program(GLuint program, std::set< std::string > const &per_instance) const {
 	//create a new vertex array object:
 	GLuint vao = 0;
 	glGenVertexArrays(1, &vao);
-	glBindVertexArray(vao);
+	gl_state.bind_vertex_array(vao);
 
 	//Try to bind all attributes in this buffer:
 	std::set< GLuint > bound;
-	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	gl_state.bind_buffer(GL_ARRAY_BUFFER, buffer);
 	auto bind_attribute = [&](char const *name, MeshBuffer::Attrib const &attrib) {
 		if (attrib.size == 0) return; //don't bind empty attribs
 		GLint location = glGetAttribLocation(program, name);
@@ -127,8 +546,10 @@ GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
 	bind_attribute("Normal", Normal);
 	bind_attribute("Color", Color);
 	bind_attribute("TexCoord", TexCoord);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+	gl_state.bind_buffer(GL_ARRAY_BUFFER, 0);
+	//(the element array binding is part of the vertex array object's state, so it stays with the vao)
+	if (index_buffer) gl_state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+	gl_state.bind_vertex_array(0);
 
 	//Check that all active attributes were bound:
 	GLint active = 0;
@@ -141,6 +562,7 @@ GLuint MeshBuffer::make_vao_for_program(GLuint program) const {
 		glGetActiveAttrib(program, i, 100, NULL, &size, &type, name);
 		name[99] = '\0';
 		GLint location = glGetAttribLocation(program, name);
+		if (per_instance.count(name)) continue;
 		if (!bound.count(GLuint(location))) {
 			throw std::runtime_error("ERROR: active attribute '" + std::string(name) + "' in program is not bound.");
 		}
@@ -6,14 +6,27 @@
  * A "MeshBuffer" holds a collection of such meshes (loaded from a file) in
  *  a single OpenGL array buffer. Individual meshes can be looked up by name
  *  using the MeshBuffer::lookup() function.
+ * Vertices are either full-precision floats (36 bytes) or, for files
+ *  written with 'index-meshes --quantize', packed into 20 bytes; the
+ *  Attrib members below describe whichever format was loaded.
+ * MeshBuffers can also be loaded in the background (see the 'Background'
+ *  constructor): the file is decoded on another thread and uploaded a slice
+ *  per frame by MeshBuffer::upload_pending(); meshes appear once ready().
+ * Meshes also have integer IDs (their index in the buffer), so code that
+ *  uses a mesh often can resolve its name once (find_id / resolve) and then
+ *  use MeshBuffer::get().
  *
  */
 
 #include "GL.hpp"
 #include <glm/glm.hpp>
-#include <map>
+#include <functional>
+#include <memory>
+#include <set>
 #include <limits>
 #include <string>
+#include <string_view>
+#include <vector>
 
 
 struct Mesh {
@@ -23,10 +36,20 @@ struct Mesh {
 	GLuint start = 0; //index of first vertex
 	GLuint count = 0; //count of vertices
 
+	//Indexed meshes (index_count > 0) are drawn from the MeshBuffer's element array with glDrawElementsBaseVertex;
+	// their indices are relative to 'start':
+	GLenum index_type = GL_UNSIGNED_INT; //GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	GLuint index_start = 0; //index of first index
+	GLuint index_count = 0; //count of indices (0 => not indexed)
+
 	//Bounding box.
 	//useful for debug visualization and (perhaps, eventually) collision detection:
 	glm::vec3 min = glm::vec3( std::numeric_limits< float >::infinity());
 	glm::vec3 max = glm::vec3(-std::numeric_limits< float >::infinity());
+
+	//Meshes from quantized files store positions in [0,1]^3 over their bounds; this takes them back to object space:
+	// (copy it to Scene::Drawable::Pipeline::dequantize; identity for full-precision meshes)
+	glm::mat4x3 dequantize = glm::mat4x3(1.0f);
 };
 
 struct MeshBuffer {
@@ -34,21 +57,78 @@ struct MeshBuffer {
 	// note: will throw if file fails to read.
 	MeshBuffer(std::string const &filename);
 
+	//construct from a file without blocking:
+	// the file is mapped and its table of contents read right away (so make_vao_for_program works immediately),
+	// then it is decompressed and checked on a background thread and uploaded by upload_pending() over the next frames.
+	// note: will throw if the file fails to open; later decode errors are recorded in 'error' (see failed()).
+	struct Background { };
+	MeshBuffer(std::string const &filename, Background);
+	~MeshBuffer();
+
+	MeshBuffer(MeshBuffer const &) = delete;
+	MeshBuffer &operator=(MeshBuffer const &) = delete;
+
+	//have the meshes been uploaded? (always true for buffers not loaded in the background)
+	// (until then the buffer has no meshes: lookup() throws and find_id() returns -1U)
+	bool ready() const { return !pending && error.empty(); }
+	//did decoding a background load fail? (the buffer then never gets any meshes; 'error' says why)
+	bool failed() const { return !error.empty(); }
+	std::string error;
+	//call 'fn' (on the main thread) once the buffer is ready or has failed -- or right away, if it already has:
+	// (so check failed() in 'fn')
+	void on_ready(std::function< void() > const &fn) const;
+
+	//upload up to 'byte_budget' bytes for buffers loaded in the background, finishing any that are complete:
+	// (call once per frame from the thread with the GL context; main.cpp does this)
+	// (never throws for a bad file: a buffer whose data fails to decode is marked failed() and its on_ready functions run,
+	//  so whoever owns it decides what to do -- the frame loop keeps running)
+	static void upload_pending(size_t byte_budget = UploadBytesPerFrame);
+	static constexpr size_t UploadBytesPerFrame = 4 << 20;
+
 	//look up a particular mesh by name:
 	// note: will throw if mesh not found.
 	const Mesh &lookup(std::string const &name) const;
+
+	//look up a mesh's ID by name (-1U if not found):
+	uint32_t find_id(std::string_view name) const;
+	//look up the IDs of many meshes at once: (*ids)[i] = find_id(names[i])
+	void resolve(std::vector< std::string_view > const &names, std::vector< uint32_t > *ids) const;
+
+	//meshes by ID:
+	// note: get() will throw if id is out of range.
+	const Mesh &get(uint32_t id) const;
+	std::string const &get_name(uint32_t id) const { return mesh_names.at(id); }
+	uint32_t mesh_count() const { return uint32_t(meshes.size()); }
 	
 	//build a vertex array object that links this vbo to attributes to a program:
 	// note: will throw if program defines attributes not contained in this buffer
-	GLuint make_vao_for_program(GLuint program) const;
+	// (except those named in 'per_instance', which are left for the caller -- e.g., Scene::draw -- to bind)
+	GLuint make_vao_for_program(GLuint program, std::set< std::string > const &per_instance = {}) const;
 
 	//This is the OpenGL vertex buffer object containing the mesh data:
 	GLuint buffer = 0;
+	//..and, for indexed files, the buffer of element indices (bound into every vao made by make_vao_for_program):
+	GLuint index_buffer = 0;
+	GLenum index_type = GL_UNSIGNED_INT;
 
 	//-- internals ---
 
-	//used by the lookup() function:
-	std::map< std::string, Mesh > meshes;
+	//meshes (and their names), by ID:
+	std::vector< Mesh > meshes;
+	std::vector< std::string > mesh_names;
+
+	//open-addressing (linear probing) hash index from names to IDs, used by lookup() and friends:
+	// (power-of-two size, at most half full; -1U marks empty buckets)
+	std::vector< uint32_t > index_buckets;
+	std::vector< uint64_t > name_hashes; //hash of each mesh's name, by ID
+	static uint64_t hash_name(std::string_view name);
+
+	void set_attribs(bool quantized);
+	void add_meshes(std::string const &filename, std::vector< Mesh > const &loaded, std::vector< std::string_view > const &names);
+
+	//decode + upload state for buffers loaded in the background (null once ready):
+	struct Pending;
+	std::unique_ptr< Pending > pending;
 
 	//These 'Attrib' structures describe the location of various attributes within the buffer (in exactly format wanted by glVertexAttribPointer). They are set when the file is loaded and are used by the "make_vao_for_program" call:
 	struct Attrib {
@@ -6,73 +6,94 @@
 #include "Mesh.hpp"
 #include "Load.hpp"
 #include "gl_errors.hpp"
+#include "gl_state.hpp"
 #include "data_path.hpp"
+#include "DataFile.hpp"
 #include "read_write_chunk.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
-#include <fstream>
 #include <random>
 
-GLuint snake_meshes_for_lit_color_texture_program = 0;
-Load< MeshBuffer > snake_meshes(LoadTagDefault, []() -> MeshBuffer const * {
-	MeshBuffer const *ret = new MeshBuffer(data_path("snake.pnct"));
-	snake_meshes_for_lit_color_texture_program = ret->make_vao_for_program(lit_color_texture_program->program);
+//the snake meshes, along with the vertex arrays that bind them to the lit color texture programs:
+// (kept in one value, so hot reload swaps in a new buffer and its vertex arrays together)
+// (loaded with the blocking constructor, not MeshBuffer::Background: snake_scene resolves mesh names and copies mesh
+//  ranges and bounds into its drawables, and PlayMode looks drawables up by name, so none of it can wait for upload_pending)
+struct SnakeMeshes : MeshBuffer {
+	SnakeMeshes(std::string const &filename) : MeshBuffer(filename) { }
+	GLuint vao_for_lit_color_texture_program = 0;
+	GLuint vao_for_lit_color_texture_instanced_program = 0;
+};
+
+Load< SnakeMeshes > snake_meshes(LoadOptions{"snake.pnct", LoadOnGLThread, {&lit_color_texture_program, &lit_color_texture_instanced_program}, LoadAtStartup, {data_path("snake.pnct")}}, []() -> SnakeMeshes const * {
+	SnakeMeshes *ret = new SnakeMeshes(data_path("snake.pnct"));
+	ret->vao_for_lit_color_texture_program = ret->make_vao_for_program(lit_color_texture_program->program);
+	ret->vao_for_lit_color_texture_instanced_program = ret->make_vao_for_program(lit_color_texture_instanced_program->program, lit_color_texture_program_per_instance);
 	return ret;
 });
 
-Load< Scene > snake_scene(LoadTagDefault, []() -> Scene const * {
-	return new Scene(data_path("snake.scene"), [&](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
-		Mesh const &mesh = snake_meshes->lookup(mesh_name);
+//(scene parsing doesn't touch GL, so it can run on a loader thread once the meshes and vaos exist)
+Load< Scene > snake_scene(LoadOptions{"snake.scene", LoadOnAnyThread, {&snake_meshes, &lit_color_texture_program, &lit_color_texture_instanced_program}, LoadAtStartup, {data_path("snake.scene")}}, []() -> Scene const * {
+	Scene *ret = new Scene();
+	//resolve all mesh names in one pass, then make drawables by mesh id:
+	ret->load(data_path("snake.scene"), [](std::vector< std::string_view > const &mesh_names, std::vector< uint32_t > *mesh_ids){
+		snake_meshes->resolve(mesh_names, mesh_ids);
+	}, [](Scene &scene, Scene::TransformHandle transform, uint32_t mesh_id){
+		Mesh const &mesh = snake_meshes->get(mesh_id);
 
-		scene.drawables.emplace_back(transform);
-		Scene::Drawable &drawable = scene.drawables.back();
+		Scene::Drawable &drawable = scene.drawables[scene.drawables.emplace(transform)];
 
 		drawable.pipeline = lit_color_texture_program_pipeline;
 
-		drawable.pipeline.vao = snake_meshes_for_lit_color_texture_program;
+		drawable.pipeline.vao = snake_meshes->vao_for_lit_color_texture_program;
+		drawable.pipeline.instanced.vao = snake_meshes->vao_for_lit_color_texture_instanced_program;
 		drawable.pipeline.type = mesh.type;
 		drawable.pipeline.start = mesh.start;
 		drawable.pipeline.count = mesh.count;
+		drawable.pipeline.index_type = mesh.index_type;
+		drawable.pipeline.index_start = mesh.index_start;
+		drawable.pipeline.index_count = mesh.index_count;
+		drawable.pipeline.dequantize = mesh.dequantize;
+		drawable.bbox_min = mesh.min;
+		drawable.bbox_max = mesh.max;
 	});
+	return ret;
 });
 
-Load< Sound::Sample > snake_bop_sample(LoadTagDefault, []() -> Sound::Sample const * {
+Load< Sound::Sample > snake_bop_sample(LoadOptions{"snake-bop.wav", LoadOnAnyThread, {}, LoadAtStartup, {data_path("snake-bop.wav")}}, []() -> Sound::Sample const * {
 	return new Sound::Sample(data_path("snake-bop.wav"));
 });
 
-PlayMode::PlayMode() : scene(*snake_scene) {
-	// Load rhythm
-	std::filebuf fb;
-	std::cout << "Loading rhythm\n";
-	{
-		std::vector< RhythmBeats > rhythm_table = std::vector< RhythmBeats >();
-		fb.open(data_path("rhythm.chunk"), std::ios::in);
-		std::istream rhythm_is(&fb);
-		read_chunk(rhythm_is, "rhy0", &rhythm_table);
-		fb.close();
-
-		rhythm = rhythm_table[0];
-		beat_index = 0;
+Load< PlayMode::RhythmBeats > snake_rhythm(LoadOptions{"rhythm.chunk", LoadOnAnyThread, {}, LoadAtStartup, {data_path("rhythm.chunk")}}, []() -> PlayMode::RhythmBeats const * {
+	DataStream file(data_path("rhythm.chunk"));
+	std::vector< PlayMode::RhythmBeats > rhythm_table;
+	read_chunk(file, "rhy0", &rhythm_table);
+	if (rhythm_table.empty() || rhythm_table[0].beat_count == 0 || rhythm_table[0].beat_count > MAX_BEATS_IN_SONG) {
+		throw std::runtime_error("Expecting rhythm.chunk to hold a rhythm with 1 to " + std::to_string(MAX_BEATS_IN_SONG) + " beats.");
 	}
+	return new PlayMode::RhythmBeats(rhythm_table[0]);
+});
 
-	std::cout << "Loading drawables\n";
-	// Get pointers to key drawables for convenience:
-	for (auto &drawable : scene.drawables) {
-		if (drawable.transform->name == "head") {
-			head = &drawable;
-			snake_head = head->transform;
-		}
-		else if (drawable.transform->name == "body") body = &drawable;
-		else if (drawable.transform->name == "apple") apple = &drawable;
-		else if (drawable.transform->name == "stem") stem = &drawable;
-		else if (drawable.transform->name == "leaf") leaf = &drawable;
-	}
-	if (head == nullptr) throw std::runtime_error("Head not found.");
-	if (body == nullptr) throw std::runtime_error("Body not found.");
-	if (apple == nullptr) throw std::runtime_error("Apple not found.");
-	if (stem == nullptr) throw std::runtime_error("Stem not found.");
-	if (leaf == nullptr) throw std::runtime_error("Leaf not found.");
+PlayMode::PlayMode() : scene(*snake_scene) {
+	rhythm = *snake_rhythm;
+	beat_index = 0;
+
+	scene_generation = snake_scene.generation;
+	rhythm_generation = snake_rhythm.generation;
+	sample_generation = snake_bop_sample.generation;
+
+	// Get handles to key drawables for convenience:
+	head = scene.find_drawable("head");
+	body = scene.find_drawable("body");
+	apple = scene.find_drawable("apple");
+	stem = scene.find_drawable("stem");
+	leaf = scene.find_drawable("leaf");
+	if (!head) throw std::runtime_error("Head not found.");
+	if (!body) throw std::runtime_error("Body not found.");
+	if (!apple) throw std::runtime_error("Apple not found.");
+	if (!stem) throw std::runtime_error("Stem not found.");
+	if (!leaf) throw std::runtime_error("Leaf not found.");
+	snake_head = scene.drawables[head].transform;
 
 	// Setup snake transform
 	snake_body = std::deque<SnakeBody*>();
@@ -80,14 +101,18 @@ PlayMode::PlayMode() : scene(*snake_scene) {
 
 	SnakeBody *snake_head_move = new SnakeBody();
 	snake_head_move->transform = snake_head;
-	snake_head_move->transform->position.z = 0;
+	{
+		glm::vec3 position = scene.transforms.get_position(snake_head);
+		position.z = 0;
+		scene.transforms.set_position(snake_head, position);
+	}
 	snake_head_move->dir = DirRight;
 	snake_head_move->next_pivot = nullptr;
 	snake_body.push_back(snake_head_move); 
 
 	// Get pointer to camera for convenience:
 	if (scene.cameras.size() != 1) throw std::runtime_error("Expecting scene to have exactly one camera, but it has " + std::to_string(scene.cameras.size()));
-	camera = &scene.cameras.front();
+	camera = &*scene.cameras.begin(); //(no cameras are added or removed after this, so the pointer stays put)
 
 	apples = std::list<Apple*>();
 	if (rhythm.beats[beat_index]) {
@@ -164,51 +189,76 @@ void PlayMode::spawn_apple() {
 	float random_xpos = rand_float(min_pos_val, max_pos_val);
 	float random_ypos = rand_float(min_pos_val, max_pos_val);
 
-	Scene::Drawable new_apple = Scene::Drawable(*apple);
-	Scene::Transform *apple_transform = new Scene::Transform();
+	Scene::Drawable new_apple = scene.drawables[apple];
+	Scene::TransformHandle apple_transform = scene.transforms.emplace("apple");
 
-	apple_transform->position = glm::vec3(random_xpos, random_ypos, apple_min_z);
+	scene.transforms.set_position(apple_transform, glm::vec3(random_xpos, random_ypos, apple_min_z));
 
 	float apple_rot = rand_float(0.0f, 2.0f * (float)M_PI);
-	apple_transform->rotation = glm::quat(std::cos(apple_rot / 2.0f), 0.0f, 0.0f, std::sin(apple_rot / 2.0f));
-	apple_transform->scale = apple->transform->scale;
+	scene.transforms.set_rotation(apple_transform, glm::quat(std::cos(apple_rot / 2.0f), 0.0f, 0.0f, std::sin(apple_rot / 2.0f)));
+	scene.transforms.set_scale(apple_transform, scene.transforms.get_scale(new_apple.transform));
 
 	new_apple.transform = apple_transform;
-	scene.drawables.push_back(new_apple);
 
 	Apple *apple_info = new Apple();
-	apple_info->drawable = &scene.drawables.back();
+	apple_info->drawable = scene.drawables.emplace(new_apple);
 	apple_info->life_timer = 0.0f;
 	apples.push_back(apple_info); 
 
-	Scene::Drawable new_stem = Scene::Drawable(*stem);
-	Scene::Transform *stem_transform = new Scene::Transform();
+	Scene::Drawable new_stem = scene.drawables[stem];
+	Scene::TransformHandle stem_transform = scene.transforms.emplace("stem", apple_transform);
 
-	stem_transform->parent = apple_transform;
-	stem_transform->position = stem->transform->position;
-	stem_transform->rotation = stem->transform->rotation;
-	stem_transform->scale = stem->transform->scale;
+	scene.transforms.set_position(stem_transform, scene.transforms.get_position(new_stem.transform));
+	scene.transforms.set_rotation(stem_transform, scene.transforms.get_rotation(new_stem.transform));
+	scene.transforms.set_scale(stem_transform, scene.transforms.get_scale(new_stem.transform));
 
 	new_stem.transform = stem_transform;
-	scene.drawables.push_back(new_stem);
-	apple_info->stem_drawable = &scene.drawables.back();
+	apple_info->stem_drawable = scene.drawables.emplace(new_stem);
 
-	Scene::Drawable new_leaf = Scene::Drawable(*leaf);
-	Scene::Transform *leaf_transform = new Scene::Transform();
+	Scene::Drawable new_leaf = scene.drawables[leaf];
+	Scene::TransformHandle leaf_transform = scene.transforms.emplace("leaf", stem_transform);
 
-	leaf_transform->parent = stem_transform;
-	leaf_transform->position = leaf->transform->position;
-	leaf_transform->rotation = leaf->transform->rotation;
-	leaf_transform->scale = leaf->transform->scale;
+	scene.transforms.set_position(leaf_transform, scene.transforms.get_position(new_leaf.transform));
+	scene.transforms.set_rotation(leaf_transform, scene.transforms.get_rotation(new_leaf.transform));
+	scene.transforms.set_scale(leaf_transform, scene.transforms.get_scale(new_leaf.transform));
 
 	new_leaf.transform = leaf_transform;
-	scene.drawables.push_back(new_leaf);
-	apple_info->leaf_drawable = &scene.drawables.back();
+	apple_info->leaf_drawable = scene.drawables.emplace(new_leaf);
+}
+
+void PlayMode::refresh_reloaded() {
+	if (scene_generation != snake_scene.generation) {
+		scene_generation = snake_scene.generation;
+		//take pipelines (vaos, mesh ranges) and bounds from the reloaded scene, by transform name,
+		// so gameplay state (positions, spawned apples, snake body) is kept:
+		Scene const &reloaded = *snake_scene;
+		for (auto &drawable : scene.drawables) {
+			Scene::DrawableHandle match = reloaded.find_drawable(scene.transforms.get_name(drawable.transform));
+			if (!match) continue;
+			Scene::Drawable const &from = reloaded.drawables[match];
+			drawable.pipeline = from.pipeline;
+			drawable.bbox_min = from.bbox_min;
+			drawable.bbox_max = from.bbox_max;
+		}
+	}
+	if (rhythm_generation != snake_rhythm.generation) {
+		rhythm_generation = snake_rhythm.generation;
+		rhythm = *snake_rhythm;
+		beat_index %= rhythm.beat_count;
+	}
+	if (sample_generation != snake_bop_sample.generation) {
+		sample_generation = snake_bop_sample.generation;
+		//restart the loop with the new sample:
+		if (song_loop) song_loop->stop();
+		song_loop = nullptr;
+	}
 }
 
-bool PlayMode::check_collision(Scene::Transform *obj1, Scene::Transform *obj2, float bound) {
-	if (std::max(obj1->position.x, obj2->position.x) - bound > std::min(obj1->position.x, obj2->position.x) + bound ||
-		std::max(obj1->position.y, obj2->position.y) - bound > std::min(obj1->position.y, obj2->position.y) + bound) 
+bool PlayMode::check_collision(Scene::TransformHandle obj1, Scene::TransformHandle obj2, float bound) {
+	glm::vec3 const &pos1 = scene.transforms.get_position(obj1);
+	glm::vec3 const &pos2 = scene.transforms.get_position(obj2);
+	if (std::max(pos1.x, pos2.x) - bound > std::min(pos1.x, pos2.x) + bound ||
+		std::max(pos1.y, pos2.y) - bound > std::min(pos1.y, pos2.y) + bound) 
 	{
 		return false;
 	}
@@ -220,7 +270,7 @@ void PlayMode::check_snake_eat() {
 	std::vector<Apple*> to_delete = std::vector<Apple*>();
 
 	for (auto &apple_info : apples) {
-		Scene::Transform *apple_t = apple_info->drawable->transform;
+		Scene::TransformHandle apple_t = scene.drawables[apple_info->drawable].transform;
 
 		if (!check_collision(snake_head, apple_t, 0.8f)) {
 			// No intersection
@@ -238,34 +288,36 @@ void PlayMode::check_snake_eat() {
 		hunger_growth_rate += 0.005f;
 
 		// Add to snake body
-		Scene::Drawable new_body = Scene::Drawable(*body);
-		Scene::Transform *transform = new Scene::Transform();
+		Scene::Drawable new_body = scene.drawables[body];
+		Scene::TransformHandle transform = scene.transforms.emplace("body");
 
-		glm::vec3 last_snake_pos = snake_body.back()->transform->position;
+		glm::vec3 last_snake_pos = scene.transforms.get_position(snake_body.back()->transform);
+		glm::vec3 position = last_snake_pos;
 		switch (snake_body.back()->dir) {
 			case DirUp:
-				transform->position = glm::vec3(last_snake_pos.x, last_snake_pos.y - 2, 0);
+				position = glm::vec3(last_snake_pos.x, last_snake_pos.y - 2, 0);
 				break;
 			case DirDown:
-				transform->position = glm::vec3(last_snake_pos.x, last_snake_pos.y + 2, 0);
+				position = glm::vec3(last_snake_pos.x, last_snake_pos.y + 2, 0);
 				break;
 			case DirRight:
-				transform->position = glm::vec3(last_snake_pos.x - 2, last_snake_pos.y, 0);
+				position = glm::vec3(last_snake_pos.x - 2, last_snake_pos.y, 0);
 				break;
 			case DirLeft:
-				transform->position = glm::vec3(last_snake_pos.x + 2, last_snake_pos.y, 0);
+				position = glm::vec3(last_snake_pos.x + 2, last_snake_pos.y, 0);
 				break;
 		}
+		position.z = 0;
 
-		transform->rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
-		transform->scale = snake_body.back()->transform->scale;
+		scene.transforms.set_position(transform, position);
+		scene.transforms.set_rotation(transform, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+		scene.transforms.set_scale(transform, scene.transforms.get_scale(snake_body.back()->transform));
 
 		new_body.transform = transform;
-		scene.drawables.push_back(new_body);
+		scene.drawables.emplace(new_body);
 
 		SnakeBody *snake_body_move = new SnakeBody();
 		snake_body_move->transform = transform;
-		snake_body_move->transform->position.z = 0;
 		snake_body_move->dir = snake_body.back()->dir;
 		snake_body_move->next_pivot = snake_body.back()->next_pivot;
 		snake_body.push_back(snake_body_move); 
@@ -277,10 +329,11 @@ void PlayMode::check_snake_eat() {
 void PlayMode::check_snake_collision() {
 	// Knowing that the snakes and apple sizes are all 1
 	for (auto &snake_part : snake_body) {
-		Scene::Transform *snake_part_t = snake_part->transform;
+		Scene::TransformHandle snake_part_t = snake_part->transform;
 
 		if (snake_part_t == snake_head) {
-			if (std::abs(snake_head->position.x) > max_pos_val || std::abs(snake_head->position.y) > max_pos_val) {
+			glm::vec3 const &head_pos = scene.transforms.get_position(snake_head);
+			if (std::abs(head_pos.x) > max_pos_val || std::abs(head_pos.y) > max_pos_val) {
 				gameOver = true;
 				break;
 			}
@@ -298,15 +351,35 @@ void PlayMode::check_snake_collision() {
 }
 
 void PlayMode::remove_apples(std::vector<Apple*> to_delete) {
+	if (to_delete.empty()) return;
+
 	for (auto &apple_info : to_delete) {
-		scene.drawables.remove_if([apple_info](auto &draw){ return draw.transform == apple_info->drawable->transform; });
-		scene.drawables.remove_if([apple_info](auto &draw){ return draw.transform == apple_info->stem_drawable->transform; });
-		scene.drawables.remove_if([apple_info](auto &draw){ return draw.transform == apple_info->leaf_drawable->transform; });
-		apples.remove(apple_info);
+		if (apple_info->removed) continue;
+		apple_info->removed = true;
+
+		Scene::TransformHandle apple_t = scene.drawables[apple_info->drawable].transform;
+		Scene::TransformHandle stem_t = scene.drawables[apple_info->stem_drawable].transform;
+		Scene::TransformHandle leaf_t = scene.drawables[apple_info->leaf_drawable].transform;
+		scene.drawables.erase(apple_info->drawable);
+		scene.drawables.erase(apple_info->stem_drawable);
+		scene.drawables.erase(apple_info->leaf_drawable);
+		//children first (an erased parent would turn them into roots):
+		scene.transforms.erase(leaf_t);
+		scene.transforms.erase(stem_t);
+		scene.transforms.erase(apple_t);
 	}
+
+	//drop all removed apples in one pass:
+	apples.remove_if([](Apple *apple_info){
+		if (!apple_info->removed) return false;
+		delete apple_info;
+		return true;
+	});
 }
 
 void PlayMode::update(float elapsed) {
+	refresh_reloaded();
+
 	if (gameOver) return;
 
 	// Move apples:
@@ -318,8 +391,10 @@ void PlayMode::update(float elapsed) {
 				to_delete.push_back(apple_info);
 			}
 
-			apple_info->drawable->transform->position.z = 
-				apple_min_z + (apple_max_z - apple_min_z) * std::sin(apple_info->life_timer * (float(M_PI) / apple_lifetime) + (float(M_PI) / 8));
+			Scene::TransformHandle apple_t = scene.drawables[apple_info->drawable].transform;
+			glm::vec3 position = scene.transforms.get_position(apple_t);
+			position.z = apple_min_z + (apple_max_z - apple_min_z) * std::sin(apple_info->life_timer * (float(M_PI) / apple_lifetime) + (float(M_PI) / 8));
+			scene.transforms.set_position(apple_t, position);
 		}
 
 		remove_apples(to_delete);
@@ -349,7 +424,7 @@ void PlayMode::update(float elapsed) {
 		if (swap_dir) {
 			DirectionPivot *pivot = new DirectionPivot();
 			pivot->dir = new_dir;
-			pivot->pos = snake_head->position;
+			pivot->pos = scene.transforms.get_position(snake_head);
 			pivot->next = nullptr;
 			
 			if (move_buffer.size() > 0) {
@@ -365,27 +440,29 @@ void PlayMode::update(float elapsed) {
 		}
 
 		for (auto &snake_part: snake_body) {
+			glm::vec3 position = scene.transforms.get_position(snake_part->transform);
+
 			// Process movement buffer
 			if (snake_part->next_pivot != nullptr) {
 				// Signed distance based on the direction of movement
-				float dist = dir_distance(snake_part->dir, snake_part->transform->position, snake_part->next_pivot->pos);
+				float dist = dir_distance(snake_part->dir, position, snake_part->next_pivot->pos);
 				if (dist <= 0) {
 					snake_part->dir = snake_part->next_pivot->dir;
-					snake_part->transform->position = snake_part->next_pivot->pos;
+					position = snake_part->next_pivot->pos;
 
 					dist = -dist;
 					switch (snake_part->dir) {
 						case DirUp:
-							snake_part->transform->position.y += dist;
+							position.y += dist;
 							break;
 						case DirDown:
-							snake_part->transform->position.y -= dist;
+							position.y -= dist;
 							break;
 						case DirRight:
-							snake_part->transform->position.x += dist;
+							position.x += dist;
 							break;
 						case DirLeft:
-							snake_part->transform->position.x -= dist;
+							position.x -= dist;
 							break;
 					}
 					
@@ -399,18 +476,20 @@ void PlayMode::update(float elapsed) {
 
         	switch (snake_part->dir) {
 				case DirUp:
-					snake_part->transform->position.y += snake_speed * elapsed;
+					position.y += snake_speed * elapsed;
 					break;
 				case DirDown:
-					snake_part->transform->position.y -= snake_speed * elapsed;
+					position.y -= snake_speed * elapsed;
 					break;
 				case DirRight:
-					snake_part->transform->position.x += snake_speed * elapsed;
+					position.x += snake_speed * elapsed;
 					break;
 				case DirLeft:
-					snake_part->transform->position.x -= snake_speed * elapsed;
+					position.x -= snake_speed * elapsed;
 					break;
 			}
+
+			scene.transforms.set_position(snake_part->transform, position);
 		}
 
 		check_snake_eat();
@@ -450,26 +529,26 @@ void PlayMode::draw(glm::uvec2 const &drawable_size) {
 	//update camera aspect ratio for drawable:
 	camera->aspect = float(drawable_size.x) / float(drawable_size.y);
 
-	//set up light type and position for lit_color_texture_program:
-	glUseProgram(lit_color_texture_program->program);
-	glUniform1i(lit_color_texture_program->LIGHT_TYPE_int, 1);
-	glUniform3fv(lit_color_texture_program->LIGHT_DIRECTION_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 0.0f,-1.0f)));
-	
+	//set up light type and position for lit_color_texture_program (and its instanced variant):
 	float hunger_ratio = 1 - (hunger / max_hunger);
-	glUniform3fv(lit_color_texture_program->LIGHT_ENERGY_vec3, 1, glm::value_ptr(glm::vec3(1.0f, hunger_ratio * 1.0f, hunger_ratio * 0.95f)));
-	glUseProgram(0);
+	for (LitColorTextureProgram const *program : { &*lit_color_texture_program, &*lit_color_texture_instanced_program }) {
+		gl_state.use_program(program->program);
+		glUniform1i(program->LIGHT_TYPE_int, 1);
+		glUniform3fv(program->LIGHT_DIRECTION_vec3, 1, glm::value_ptr(glm::vec3(0.0f, 0.0f,-1.0f)));
+		glUniform3fv(program->LIGHT_ENERGY_vec3, 1, glm::value_ptr(glm::vec3(1.0f, hunger_ratio * 1.0f, hunger_ratio * 0.95f)));
+	}
 
 	glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
 	glClearDepth(1.0f); //1.0 is actually the default value to clear the depth buffer to, but FYI you can change it.
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glEnable(GL_DEPTH_TEST);
+	gl_state.enable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LESS); //this is the default depth comparison function, but FYI you can change it.
 
 	scene.draw(*camera);
 
 	{ //use DrawLines to overlay some text:
-		glDisable(GL_DEPTH_TEST);
+		gl_state.disable(GL_DEPTH_TEST);
 		float aspect = float(drawable_size.x) / float(drawable_size.y);
 		DrawLines lines(glm::mat4(
 			1.0f / aspect, 0.0f, 0.0f, 0.0f,
@@ -5,6 +5,7 @@
 
 #include <glm/glm.hpp>
 
+#include <list>
 #include <vector>
 #include <deque>
 
@@ -46,17 +47,22 @@ struct PlayMode : Mode {
 	uint32_t beat_index = 0;
 	float song_timer = 0;
 
+	//generations of the loads copied from above, so hot-reloaded assets can be picked up (see refresh_reloaded()):
+	uint32_t scene_generation = 0;
+	uint32_t rhythm_generation = 0;
+	uint32_t sample_generation = 0;
+
 	// Looped song:
 	std::shared_ptr< Sound::PlayingSample > song_loop = nullptr;
 
 	// Model drawables
-	Scene::Drawable *head = nullptr;
-	Scene::Drawable *body = nullptr;
-	Scene::Drawable *apple = nullptr;
-	Scene::Drawable *stem = nullptr;
-	Scene::Drawable *leaf = nullptr;
+	Scene::DrawableHandle head;
+	Scene::DrawableHandle body;
+	Scene::DrawableHandle apple;
+	Scene::DrawableHandle stem;
+	Scene::DrawableHandle leaf;
 
-	Scene::Transform *snake_head = nullptr;
+	Scene::TransformHandle snake_head;
 
 	// Snake game logic
 	enum Direction {
@@ -73,7 +79,7 @@ struct PlayMode : Mode {
 
 	struct SnakeBody {
 		Direction dir;
-		Scene::Transform *transform;
+		Scene::TransformHandle transform;
 		DirectionPivot *next_pivot;
 	};
 
@@ -83,9 +89,10 @@ struct PlayMode : Mode {
 
 	struct Apple {
 		float life_timer;
-		Scene::Drawable *drawable;
-		Scene::Drawable *stem_drawable;
-		Scene::Drawable *leaf_drawable;
+		Scene::DrawableHandle drawable;
+		Scene::DrawableHandle stem_drawable;
+		Scene::DrawableHandle leaf_drawable;
+		bool removed = false;
 	};
 
 	float apple_lifetime = 2.0f;
@@ -113,6 +120,9 @@ struct PlayMode : Mode {
 	// Find the distance along the direction
 	float dir_distance(Direction dir, glm::vec3 pos1, glm::vec3 pos2);
 
+	// Copy drawables, rhythm, and song from any assets that were hot reloaded
+	void refresh_reloaded();
+
 	// Spawn an apple at a random position on the map
 	void spawn_apple();
 
@@ -120,7 +130,7 @@ struct PlayMode : Mode {
 	void remove_apples(std::vector<Apple*> to_delete);
 
 	// Checks if collision occurs between the two given transforms
-	bool check_collision(Scene::Transform *obj1, Scene::Transform *obj2, float bound);
+	bool check_collision(Scene::TransformHandle obj1, Scene::TransformHandle obj2, float bound);
 
 	// Checks if snake head eats the apple; if so, grows the snake body
 	void check_snake_eat();
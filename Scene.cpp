@@ -1,22 +1,28 @@
 #include "Scene.hpp"
 
 #include "gl_errors.hpp"
+#include "gl_state.hpp"
+#include "WorkerPool.hpp"
 #include "read_write_chunk.hpp"
+#include "DataFile.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 
-#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
 
 //-------------------------
 
-glm::mat4x3 Scene::Transform::make_local_to_parent() const {
-	//compute:
-	//   translate   *   rotate    *   scale
-	// [ 1 0 0 p.x ]   [       0 ]   [ s.x 0 0 0 ]
-	// [ 0 1 0 p.y ] * [ rot   0 ] * [ 0 s.y 0 0 ]
-	// [ 0 0 1 p.z ]   [       0 ]   [ 0 0 s.z 0 ]
-	//                 [ 0 0 0 1 ]   [ 0 0   0 1 ]
-
+//compute:
+//   translate   *   rotate    *   scale
+// [ 1 0 0 p.x ]   [       0 ]   [ s.x 0 0 0 ]
+// [ 0 1 0 p.y ] * [ rot   0 ] * [ 0 s.y 0 0 ]
+// [ 0 0 1 p.z ]   [       0 ]   [ 0 0 s.z 0 ]
+//                 [ 0 0 0 1 ]   [ 0 0   0 1 ]
+static glm::mat4x3 make_local_to_parent(glm::vec3 const &position, glm::quat const &rotation, glm::vec3 const &scale) {
 	glm::mat3 rot = glm::mat3_cast(rotation);
 	return glm::mat4x3(
 		rot[0] * scale.x, //scaling the columns here means that scale happens before rotation
@@ -26,14 +32,13 @@ glm::mat4x3 Scene::Transform::make_local_to_parent() const {
 	);
 }
 
-glm::mat4x3 Scene::Transform::make_parent_to_local() const {
-	//compute:
-	//   1/scale       *    rot^-1   *  translate^-1
-	// [ 1/s.x 0 0 0 ]   [       0 ]   [ 0 0 0 -p.x ]
-	// [ 0 1/s.y 0 0 ] * [rot^-1 0 ] * [ 0 0 0 -p.y ]
-	// [ 0 0 1/s.z 0 ]   [       0 ]   [ 0 0 0 -p.z ]
-	//                   [ 0 0 0 1 ]   [ 0 0 0  1   ]
-
+//compute:
+//   1/scale       *    rot^-1   *  translate^-1
+// [ 1/s.x 0 0 0 ]   [       0 ]   [ 0 0 0 -p.x ]
+// [ 0 1/s.y 0 0 ] * [rot^-1 0 ] * [ 0 0 0 -p.y ]
+// [ 0 0 1/s.z 0 ]   [       0 ]   [ 0 0 0 -p.z ]
+//                   [ 0 0 0 1 ]   [ 0 0 0  1   ]
+static glm::mat4x3 make_parent_to_local(glm::vec3 const &position, glm::quat const &rotation, glm::vec3 const &scale) {
 	glm::vec3 inv_scale;
 	//taking some care so that we don't end up with NaN's , just a degenerate matrix, if scale is zero:
 	inv_scale.x = (scale.x == 0.0f ? 0.0f : 1.0f / scale.x);
@@ -56,19 +61,337 @@ glm::mat4x3 Scene::Transform::make_parent_to_local() const {
 	);
 }
 
-glm::mat4x3 Scene::Transform::make_local_to_world() const {
-	if (!parent) {
-		return make_local_to_parent();
-	} else {
-		return parent->make_local_to_world() * glm::mat4(make_local_to_parent()); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
+Scene::NameTable::NameTable() {
+	intern("");
+}
+
+uint32_t Scene::NameTable::intern(std::string_view name) {
+	auto f = atoms.find(name);
+	if (f != atoms.end()) return f->second;
+	uint32_t atom = uint32_t(strings.size());
+	strings.emplace_back(name);
+	atoms.emplace(std::string_view(strings.back()), atom);
+	return atom;
+}
+
+uint32_t Scene::NameTable::find(std::string_view name) const {
+	auto f = atoms.find(name);
+	return (f == atoms.end() ? -1U : f->second);
+}
+
+Scene::TransformHandle Scene::TransformStore::emplace(std::string const &name, TransformHandle parent) {
+	uint32_t parent_index = -1U;
+	if (parent) parent_index = index(parent);
+
+	uint32_t i = uint32_t(parents.size());
+	TransformHandle handle = slots.allocate< TransformStore >(i);
+	if (attached.size() < slots.slots.size()) attached.resize(slots.slots.size(), 0);
+
+	//new transforms go at the end, which is always after their parent:
+	positions.emplace_back(0.0f, 0.0f, 0.0f);
+	rotations.emplace_back(1.0f, 0.0f, 0.0f, 0.0f); //n.b. wxyz init order
+	scales.emplace_back(1.0f, 1.0f, 1.0f);
+	parents.emplace_back(parent_index);
+	name_atoms.emplace_back(name_table->intern(name));
+	index_slots.emplace_back(handle.slot);
+	flags.emplace_back(uint8_t(FlagDirty | FlagWorldToLocalStale));
+	local_to_worlds.emplace_back(1.0f);
+	world_to_locals.emplace_back(1.0f);
+	if (i < first_dirty) first_dirty = i;
+	levels_stale = true;
+
+	return handle;
+}
+
+void Scene::TransformStore::erase(TransformHandle transform) {
+	uint32_t i = index(transform);
+	if (attached[transform.slot] != 0) {
+		//(erasing would leave those objects with a stale handle)
+		throw std::runtime_error("Erasing transform '" + name_table->get(name_atoms[i]) + "' while " + std::to_string(attached[transform.slot]) + " drawable(s)/camera(s)/light(s) still refer to it.");
+	}
+	slots.release(index_slots[i]);
+	index_slots[i] = -1U;
+
+	//erased transforms are left in place (update() treats their children as roots) and dropped in bulk later:
+	flags[i] = FlagDead;
+	dead_count += 1;
+	if (i < first_dirty) first_dirty = i;
+
+	if (dead_count > 64 && dead_count * 2 > uint32_t(parents.size())) {
+		compact();
+	}
+}
+
+void Scene::TransformStore::clear() {
+	for (uint32_t count : attached) {
+		if (count != 0) throw std::runtime_error("Clearing transforms while drawables, cameras, or lights still refer to them.");
+	}
+	positions.clear();
+	rotations.clear();
+	scales.clear();
+	parents.clear();
+	name_atoms.clear();
+	index_slots.clear();
+	flags.clear();
+	local_to_worlds.clear();
+	world_to_locals.clear();
+	//(slots are released rather than rebuilt, so handles from before -- including cached parents -- stay stale)
+	slots.release_all();
+	//(every count in 'attached' is zero, as checked above, and it stays sized to match the slots)
+	dead_count = 0;
+	first_dirty = -1U;
+	levels_stale = true;
+}
+
+void Scene::TransformStore::set_parent(TransformHandle transform, TransformHandle parent) {
+	uint32_t i = index(transform);
+	uint32_t p = (parent ? index(parent) : -1U);
+	for (uint32_t a = p; a != -1U; a = parents[a]) {
+		if (a == i) throw std::runtime_error("set_parent would make transform '" + name_table->get(name_atoms[i]) + "' its own ancestor");
+	}
+	parents[i] = p;
+	mark_dirty(i);
+	levels_stale = true;
+	if (p != -1U && p > i) sort();
+}
+
+void Scene::TransformStore::compact() {
+	//old index -> new index:
+	std::vector< uint32_t > remap(parents.size(), -1U);
+
+	uint32_t next = 0;
+	for (uint32_t i = 0; i < uint32_t(parents.size()); ++i) {
+		if (flags[i] & FlagDead) continue;
+		remap[i] = next;
+		if (next != i) {
+			positions[next] = positions[i];
+			rotations[next] = rotations[i];
+			scales[next] = scales[i];
+			parents[next] = parents[i];
+			name_atoms[next] = name_atoms[i];
+			index_slots[next] = index_slots[i];
+			flags[next] = flags[i];
+			local_to_worlds[next] = local_to_worlds[i];
+			world_to_locals[next] = world_to_locals[i];
+		}
+		//parents come first, so they have already been remapped (children of erased transforms become roots):
+		if (parents[next] != -1U) {
+			uint32_t p = remap[parents[next]];
+			if (p == -1U) flags[next] |= FlagDirty;
+			parents[next] = p;
+		}
+		slots.slots[index_slots[next]].index = next;
+		++next;
+	}
+
+	positions.resize(next);
+	rotations.resize(next);
+	scales.resize(next);
+	parents.resize(next);
+	name_atoms.resize(next);
+	index_slots.resize(next);
+	flags.resize(next);
+	local_to_worlds.resize(next);
+	world_to_locals.resize(next);
+	dead_count = 0;
+	first_dirty = 0; //(indices have moved, so be conservative)
+	levels_stale = true;
+}
+
+void Scene::TransformStore::sort() {
+	//drop anything erased first, so everything left is live:
+	compact();
+
+	uint32_t count = uint32_t(parents.size());
+
+	//order transforms depth-first from the roots (stable w.r.t. existing order among siblings):
+	std::vector< uint32_t > first_child(count, -1U), next_sibling(count, -1U);
+	for (uint32_t i = count - 1; i < count; --i) {
+		if (parents[i] == -1U) continue;
+		next_sibling[i] = first_child[parents[i]];
+		first_child[parents[i]] = i;
+	}
+	std::vector< uint32_t > order;
+	order.reserve(count);
+	std::vector< uint32_t > stack;
+	for (uint32_t r = count - 1; r < count; --r) {
+		if (parents[r] == -1U) stack.emplace_back(r);
+	}
+	while (!stack.empty()) {
+		uint32_t i = stack.back();
+		stack.pop_back();
+		order.emplace_back(i);
+		std::vector< uint32_t > children;
+		for (uint32_t c = first_child[i]; c != -1U; c = next_sibling[c]) children.emplace_back(c);
+		stack.insert(stack.end(), children.rbegin(), children.rend());
+	}
+	assert(order.size() == count && "set_parent() should have prevented cycles");
+
+	std::vector< uint32_t > remap(count);
+	for (uint32_t n = 0; n < count; ++n) remap[order[n]] = n;
+
+	auto permute = [&order](auto &vec) {
+		std::remove_reference_t< decltype(vec) > sorted;
+		sorted.reserve(vec.size());
+		for (uint32_t o : order) sorted.emplace_back(std::move(vec[o]));
+		vec = std::move(sorted);
+	};
+	permute(positions);
+	permute(rotations);
+	permute(scales);
+	permute(parents);
+	permute(name_atoms);
+	permute(index_slots);
+	permute(flags);
+	permute(local_to_worlds);
+	permute(world_to_locals);
+
+	for (uint32_t n = 0; n < count; ++n) {
+		if (parents[n] != -1U) parents[n] = remap[parents[n]];
+		slots.slots[index_slots[n]].index = n;
+	}
+}
+
+glm::mat4x3 Scene::TransformStore::make_local_to_parent(TransformHandle transform) const {
+	uint32_t i = index(transform);
+	return ::make_local_to_parent(positions[i], rotations[i], scales[i]);
+}
+
+glm::mat4x3 Scene::TransformStore::make_parent_to_local(TransformHandle transform) const {
+	uint32_t i = index(transform);
+	return ::make_parent_to_local(positions[i], rotations[i], scales[i]);
+}
+
+void Scene::TransformStore::update() const {
+	if (first_dirty == -1U) return;
+	if (parents.size() >= ParallelThreshold) {
+		update(WorkerPool::shared());
+		return;
+	}
+
+	uint32_t count = uint32_t(parents.size());
+
+	//everything before the first change (and so, since parents come first, none of its ancestors changed) is current:
+	// (so the passes below cost in proportion to the tail of the store that could have changed)
+	uint32_t start = first_dirty;
+
+	//(1) push dirty flags down the hierarchy (parents come before children, so one pass suffices):
+	for (uint32_t i = start; i < count; ++i) {
+		uint32_t p = parents[i];
+		if (p != -1U && (flags[p] & (FlagDirty | FlagDead))) {
+			flags[i] |= FlagDirty; //(a dead parent is also a change: the child is now a root)
+		}
+	}
+
+	//(2) build local-to-parent matrices for dirty transforms (independent of each other):
+	for (uint32_t i = start; i < count; ++i) {
+		if ((flags[i] & (FlagDirty | FlagDead)) != FlagDirty) continue;
+		local_to_worlds[i] = ::make_local_to_parent(positions[i], rotations[i], scales[i]);
+	}
+
+	//(3) concatenate with parent matrices, in parent-before-child order:
+	for (uint32_t i = start; i < count; ++i) {
+		if ((flags[i] & (FlagDirty | FlagDead)) != FlagDirty) continue;
+		uint32_t p = parents[i];
+		if (p != -1U && !(flags[p] & FlagDead)) {
+			local_to_worlds[i] = local_to_worlds[p] * glm::mat4(local_to_worlds[i]); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
+		}
+		flags[i] = uint8_t((flags[i] & ~FlagDirty) | FlagWorldToLocalStale);
+	}
+
+	first_dirty = -1U;
+}
+
+void Scene::TransformStore::build_levels() const {
+	uint32_t count = uint32_t(parents.size());
+
+	//depth of every transform (parents come before children, so one pass suffices):
+	std::vector< uint32_t > depths(count);
+	uint32_t max_depth = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		uint32_t p = parents[i];
+		depths[i] = (p == -1U ? 0 : depths[p] + 1);
+		max_depth = std::max(max_depth, depths[i]);
+	}
+
+	//counting sort by depth (stable, so each level stays in store order):
+	level_starts.assign(count ? max_depth + 2 : 1, 0);
+	for (uint32_t i = 0; i < count; ++i) level_starts[depths[i] + 1] += 1;
+	for (uint32_t d = 1; d < level_starts.size(); ++d) level_starts[d] += level_starts[d-1];
+	level_order.resize(count);
+	std::vector< uint32_t > next(level_starts.begin(), level_starts.end() - 1);
+	for (uint32_t i = 0; i < count; ++i) level_order[next[depths[i]]++] = i;
+
+	levels_stale = false;
+}
+
+void Scene::TransformStore::update(WorkerPool &workers) const {
+	if (first_dirty == -1U) return;
+
+	uint32_t count = uint32_t(parents.size());
+
+	//(1) push dirty flags down the hierarchy (cheap byte operations; done serially, from the first change):
+	for (uint32_t i = first_dirty; i < count; ++i) {
+		uint32_t p = parents[i];
+		if (p != -1U && (flags[p] & (FlagDirty | FlagDead))) {
+			flags[i] |= FlagDirty; //(a dead parent is also a change: the child is now a root)
+		}
+	}
+
+	//(2+3) one hierarchy level at a time, build and concatenate matrices for dirty transforms:
+	// every transform in a level depends only on the previous level, so a level can be split across threads;
+	// each matrix is computed exactly as in the serial path, so the results don't depend on the thread count.
+	if (levels_stale) build_levels();
+
+	constexpr uint32_t Grain = 2048; //transforms per chunk
+
+	for (uint32_t d = 0; d + 1 < level_starts.size(); ++d) {
+		uint32_t const *level = level_order.data() + level_starts[d];
+		workers.parallel_for(level_starts[d+1] - level_starts[d], Grain, [&](uint32_t begin, uint32_t end){
+			for (uint32_t l = begin; l < end; ++l) {
+				uint32_t i = level[l];
+				if ((flags[i] & (FlagDirty | FlagDead)) != FlagDirty) continue;
+				glm::mat4x3 local_to_parent = ::make_local_to_parent(positions[i], rotations[i], scales[i]);
+				uint32_t p = parents[i];
+				if (p != -1U && !(flags[p] & FlagDead)) {
+					local_to_worlds[i] = local_to_worlds[p] * glm::mat4(local_to_parent);
+				} else {
+					local_to_worlds[i] = local_to_parent;
+				}
+				flags[i] = uint8_t((flags[i] & ~FlagDirty) | FlagWorldToLocalStale);
+			}
+		});
 	}
+
+	first_dirty = -1U;
+}
+
+glm::mat4x3 const &Scene::TransformStore::get_local_to_world(TransformHandle transform) const {
+	uint32_t i = index(transform);
+	update();
+	return local_to_worlds[i];
 }
-glm::mat4x3 Scene::Transform::make_world_to_local() const {
-	if (!parent) {
-		return make_parent_to_local();
-	} else {
-		return make_parent_to_local() * glm::mat4(parent->make_world_to_local()); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
+
+glm::mat4x3 const &Scene::TransformStore::get_world_to_local(TransformHandle transform) const {
+	uint32_t i = index(transform);
+	update();
+
+	//world-to-local matrices are only built on request (walking up to the nearest ancestor that is current):
+	std::vector< uint32_t > chain;
+	for (uint32_t c = i; c != -1U && !(flags[c] & FlagDead) && (flags[c] & FlagWorldToLocalStale); c = parents[c]) {
+		chain.emplace_back(c);
+	}
+	for (auto ci = chain.rbegin(); ci != chain.rend(); ++ci) {
+		uint32_t c = *ci;
+		uint32_t p = parents[c];
+		world_to_locals[c] = ::make_parent_to_local(positions[c], rotations[c], scales[c]);
+		if (p != -1U && !(flags[p] & FlagDead)) {
+			world_to_locals[c] = world_to_locals[c] * glm::mat4(world_to_locals[p]); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
+		}
+		flags[c] &= ~FlagWorldToLocalStale;
 	}
+
+	return world_to_locals[i];
 }
 
 //-------------------------
@@ -82,14 +405,115 @@ glm::mat4 Scene::Camera::make_projection() const {
 
 void Scene::draw(Camera const &camera) const {
 	assert(camera.transform);
-	glm::mat4 world_to_clip = camera.make_projection() * glm::mat4(camera.transform->make_world_to_local());
+	//n.b. camera must belong to this scene:
+	glm::mat4 world_to_clip = camera.make_projection() * glm::mat4(transforms.get_world_to_local(camera.transform));
 	glm::mat4x3 world_to_light = glm::mat4x3(1.0f);
 	draw(world_to_clip, world_to_light);
 }
 
+//sort-key layout used by Scene::draw, most significant first:
+// [63..52] program | [51..40] vertex array | [39..28] texture unit 0 | [27..16] mesh | [15..0] depth (near to far)
+// (GL names are truncated to 12 bits; a collision only makes grouping less perfect -- actual state is always compared before skipping a bind)
+static uint64_t make_sort_key(Scene::Drawable::Pipeline const &pipeline, float depth) {
+	//for non-negative floats, the bit pattern is monotonic in the value; keep the top 16 bits:
+	depth = std::max(depth, 0.0f);
+	uint32_t depth_bits;
+	static_assert(sizeof(depth_bits) == sizeof(depth), "float is 32 bits");
+	std::memcpy(&depth_bits, &depth, sizeof(depth_bits));
+
+	//the mesh (vertex + index range) goes above depth so that copies of the same mesh end up adjacent (and can be instanced):
+	uint32_t mesh_bits = ((pipeline.start * 2654435761U) ^ pipeline.count ^ (pipeline.index_start * 40503U) ^ pipeline.index_count) >> 20;
+
+	return (uint64_t(pipeline.program & 0xfff) << 52)
+	     | (uint64_t(pipeline.vao & 0xfff) << 40)
+	     | (uint64_t(pipeline.textures[0].texture & 0xfff) << 28)
+	     | (uint64_t(mesh_bits & 0xfff) << 16)
+	     | uint64_t(depth_bits >> 16);
+}
+
+//byte offset of an indexed pipeline's first index in its element array buffer:
+static void const *index_offset(Scene::Drawable::Pipeline const &pipeline) {
+	size_t index_size = (pipeline.index_type == GL_UNSIGNED_SHORT ? 2 : (pipeline.index_type == GL_UNSIGNED_BYTE ? 1 : 4));
+	return reinterpret_cast< void const * >(size_t(pipeline.index_start) * index_size);
+}
+
+//can 'b' be drawn as another instance of 'a'?
+static bool can_instance_together(Scene::Drawable::Pipeline const &a, Scene::Drawable::Pipeline const &b) {
+	if (a.instanced.program == 0 || a.set_uniforms || b.set_uniforms) return false;
+	if (a.program != b.program || a.vao != b.vao) return false;
+	if (a.type != b.type || a.start != b.start || a.count != b.count) return false;
+	if (a.index_type != b.index_type || a.index_start != b.index_start || a.index_count != b.index_count) return false;
+	for (uint32_t i = 0; i < Scene::Drawable::Pipeline::TextureCount; ++i) {
+		if (a.textures[i].texture != b.textures[i].texture) return false;
+		if (a.textures[i].texture != 0 && a.textures[i].target != b.textures[i].target) return false;
+	}
+	return a.instanced.program == b.instanced.program
+	    && a.instanced.vao == b.instanced.vao
+	    && a.instanced.OBJECT_TO_WORLD_mat4x3 == b.instanced.OBJECT_TO_WORLD_mat4x3
+	    && a.instanced.NORMAL_TO_LIGHT_mat3 == b.instanced.NORMAL_TO_LIGHT_mat3
+	    && a.instanced.WORLD_TO_CLIP_mat4 == b.instanced.WORLD_TO_CLIP_mat4
+	    && a.instanced.WORLD_TO_LIGHT_mat4x3 == b.instanced.WORLD_TO_LIGHT_mat4x3;
+}
+
+//LSD radix sort on 'key', eight bits per pass; passes where every key has the same byte are skipped:
+template< typename T >
+static void radix_sort(std::vector< T > *items_, std::vector< T > *scratch_) {
+	auto &items = *items_;
+	auto &scratch = *scratch_;
+	scratch.resize(items.size());
+
+	uint64_t all_and = ~uint64_t(0);
+	uint64_t all_or = 0;
+	for (T const &item : items) {
+		all_and &= item.key;
+		all_or |= item.key;
+	}
+	uint64_t varying = all_and ^ all_or; //bits that are not the same in every key
+
+	for (uint32_t shift = 0; shift < 64; shift += 8) {
+		if (((varying >> shift) & 0xff) == 0) continue;
+
+		uint32_t offsets[256] = { };
+		for (T const &item : items) {
+			offsets[(item.key >> shift) & 0xff] += 1;
+		}
+		uint32_t total = 0;
+		for (uint32_t &o : offsets) {
+			uint32_t count = o;
+			o = total;
+			total += count;
+		}
+		for (T const &item : items) {
+			scratch[offsets[(item.key >> shift) & 0xff]++] = item;
+		}
+		items.swap(scratch);
+	}
+}
+
 void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light) const {
 
-	//Iterate through all drawables, sending each one to OpenGL:
+	//Bring all world matrices up to date in one pass:
+	transforms.update();
+
+	DrawStats stats;
+
+	//Build a render queue of sort keys so that drawables that share state end up next to each other:
+	// (drawables with bounding boxes are held back in cull_items for frustum culling)
+	using RenderItem = DrawScratch::RenderItem;
+	auto &queue = draw_scratch.queue;
+	auto &cull_items = draw_scratch.cull_items;
+	auto &cull_cx = draw_scratch.cull_cx, &cull_cy = draw_scratch.cull_cy, &cull_cz = draw_scratch.cull_cz;
+	auto &cull_ex = draw_scratch.cull_ex, &cull_ey = draw_scratch.cull_ey, &cull_ez = draw_scratch.cull_ez;
+	queue.clear();
+	queue.reserve(drawables.size());
+	cull_items.clear();
+	for (auto *v : { &cull_cx, &cull_cy, &cull_cz, &cull_ex, &cull_ey, &cull_ez }) v->clear();
+
+	auto depth_of = [&world_to_clip](glm::mat4x3 const &object_to_world) {
+		//depth of object origin (clip-space w is view depth for perspective projections):
+		return (world_to_clip * glm::vec4(object_to_world[3], 1.0f)).w;
+	};
+
 	for (auto const &drawable : drawables) {
 		//Reference to drawable's pipeline for convenience:
 		Scene::Drawable::Pipeline const &pipeline = drawable.pipeline;
@@ -98,81 +522,319 @@ void Scene::draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_lig
 		if (pipeline.program == 0) continue;
 		//skip any drawables that don't reference any vertex array:
 		if (pipeline.vao == 0) continue;
-		//skip any drawables that don't contain any vertices:
-		if (pipeline.count == 0) continue;
+		//skip any drawables that don't contain any vertices (or indices):
+		if (pipeline.count == 0 && pipeline.index_count == 0) continue;
 
+		assert(drawable.transform); //drawables *must* have a transform
+		glm::mat4x3 const &object_to_world = transforms.get_local_to_world(drawable.transform);
 
-		//Set shader program:
-		glUseProgram(pipeline.program);
+		if (!(drawable.bbox_min.x <= drawable.bbox_max.x && drawable.bbox_min.y <= drawable.bbox_max.y && drawable.bbox_min.z <= drawable.bbox_max.z)) {
+			//no bounding box, so can't be culled:
+			queue.emplace_back(RenderItem{ make_sort_key(pipeline, depth_of(object_to_world)), &drawable, &object_to_world });
+			continue;
+		}
 
-		//Set attribute sources:
-		glBindVertexArray(pipeline.vao);
+		//transform the box to world space (as a world-space box that contains it):
+		glm::vec3 center = object_to_world * glm::vec4(0.5f * (drawable.bbox_min + drawable.bbox_max), 1.0f);
+		glm::vec3 half = 0.5f * (drawable.bbox_max - drawable.bbox_min);
+		glm::vec3 extent = glm::abs(object_to_world[0]) * half.x
+		                 + glm::abs(object_to_world[1]) * half.y
+		                 + glm::abs(object_to_world[2]) * half.z;
 
-		//Configure program uniforms:
+		cull_items.emplace_back(RenderItem{ 0, &drawable, &object_to_world });
+		cull_cx.emplace_back(center.x); cull_cy.emplace_back(center.y); cull_cz.emplace_back(center.z);
+		cull_ex.emplace_back(extent.x); cull_ey.emplace_back(extent.y); cull_ez.emplace_back(extent.z);
+	}
 
-		//the object-to-world matrix is used in all three of these uniforms:
-		assert(drawable.transform); //drawables *must* have a transform
-		glm::mat4x3 object_to_world = drawable.transform->make_local_to_world();
+	{ //Test boxes against the frustum planes:
+		//planes are extracted from world_to_clip (Gribb & Hartmann) -- a point is inside when dot(plane, point) >= 0:
+		// (planes are not normalized, which is fine for a sign test)
+		auto row = [&world_to_clip](uint32_t r) {
+			return glm::vec4(world_to_clip[0][r], world_to_clip[1][r], world_to_clip[2][r], world_to_clip[3][r]);
+		};
+		glm::vec4 const planes[6] = {
+			row(3) + row(0), row(3) - row(0), //left, right
+			row(3) + row(1), row(3) - row(1), //bottom, top
+			row(3) + row(2), row(3) - row(2), //near, far (degenerate, and so never culls, for infinite projections)
+		};
+
+		uint32_t count = uint32_t(cull_items.size());
+		std::vector< uint8_t > &cull_inside = draw_scratch.cull_inside;
+		cull_inside.assign(count, 1);
+
+		//one plane at a time over all boxes -- plain loops over the parallel arrays, which the compiler can vectorize:
+		float const *cx = cull_cx.data(), *cy = cull_cy.data(), *cz = cull_cz.data();
+		float const *ex = cull_ex.data(), *ey = cull_ey.data(), *ez = cull_ez.data();
+		uint8_t *inside = cull_inside.data();
+		for (glm::vec4 const &plane : planes) {
+			float const px = plane.x, py = plane.y, pz = plane.z, pw = plane.w;
+			float const ax = std::abs(px), ay = std::abs(py), az = std::abs(pz);
+			for (uint32_t i = 0; i < count; ++i) {
+				//signed distance of the box's most-inside corner:
+				float d = px * cx[i] + py * cy[i] + pz * cz[i] + pw + ax * ex[i] + ay * ey[i] + az * ez[i];
+				inside[i] &= uint8_t(d >= 0.0f);
+			}
+		}
 
-		//OBJECT_TO_CLIP takes vertices from object space to clip space:
-		if (pipeline.OBJECT_TO_CLIP_mat4 != -1U) {
-			glm::mat4 object_to_clip = world_to_clip * glm::mat4(object_to_world);
-			glUniformMatrix4fv(pipeline.OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
+		stats.drawables_cull_tested = count;
+		for (uint32_t i = 0; i < count; ++i) {
+			if (!inside[i]) {
+				stats.drawables_culled += 1;
+				continue;
+			}
+			RenderItem item = cull_items[i];
+			item.key = make_sort_key(item.drawable->pipeline, depth_of(*item.object_to_world));
+			queue.emplace_back(item);
 		}
+	}
+
+	radix_sort(&queue, &draw_scratch.sort_scratch);
+
+	//Split the sorted queue into runs; runs of two or more instanceable drawables get one instanced draw call:
+	// (per-instance data for all runs is gathered up front so it can be uploaded with one glBufferData call)
+	using InstanceData = DrawScratch::InstanceData;
+	static_assert(sizeof(InstanceData) == 4*12 + 4*9, "InstanceData is packed.");
+	auto &runs = draw_scratch.runs;
+	auto &instances = draw_scratch.instances;
+	runs.clear();
+	instances.clear();
+
+	//Single drawables whose pipelines read their matrices from the ObjectMatrices uniform block get one slice each of a uniform buffer:
+	// (slices start at multiples of GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, as required by glBindBufferRange)
+	struct ObjectMatricesStd140 {
+		glm::mat4 object_to_clip;
+		glm::vec4 object_to_light[4];
+		glm::vec4 normal_to_light[3];
+	};
+	static_assert(sizeof(ObjectMatricesStd140) == 4*16 + 4*16 + 3*16, "ObjectMatricesStd140 is packed.");
+	GLsizeiptr &block_stride = draw_scratch.block_stride;
+	if (block_stride == 0) {
+		GLint alignment = 0;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		alignment = std::max(alignment, 16);
+		block_stride = (GLsizeiptr(sizeof(ObjectMatricesStd140)) + alignment - 1) / alignment * alignment;
+	}
+	auto &object_blocks = draw_scratch.object_blocks;
+	object_blocks.clear();
+
+	for (uint32_t begin = 0; begin < queue.size(); ) {
+		Drawable::Pipeline const &pipeline = queue[begin].drawable->pipeline;
+		uint32_t end = begin + 1;
+		while (end < queue.size() && can_instance_together(pipeline, queue[end].drawable->pipeline)) ++end;
+		if (end - begin >= 2) {
+			for (uint32_t i = begin; i < end; ++i) {
+				glm::mat4x3 const &object_to_world = *queue[i].object_to_world;
+				glm::mat4x3 object_to_light = world_to_light * glm::mat4(object_to_world);
+				instances.emplace_back(InstanceData{
+					object_to_world * glm::mat4(pipeline.dequantize),
+					glm::inverse(glm::transpose(glm::mat3(object_to_light)))
+				});
+			}
+		} else {
+			end = begin + 1;
+			if (pipeline.object_matrices_block) {
+				glm::mat4x3 const &object_to_world = *queue[begin].object_to_world;
+				glm::mat4x3 object_to_light = world_to_light * glm::mat4(object_to_world);
+				glm::mat3 normal_to_light = glm::inverse(glm::transpose(glm::mat3(object_to_light)));
+				glm::mat4 dequantize = glm::mat4(pipeline.dequantize);
+
+				//std140: every matrix column is padded out to a vec4:
+				ObjectMatricesStd140 block;
+				block.object_to_clip = world_to_clip * glm::mat4(object_to_world) * dequantize;
+				glm::mat4x3 position_to_light = object_to_light * dequantize;
+				for (uint32_t c = 0; c < 4; ++c) block.object_to_light[c] = glm::vec4(position_to_light[c], 0.0f);
+				for (uint32_t c = 0; c < 3; ++c) block.normal_to_light[c] = glm::vec4(normal_to_light[c], 0.0f);
+
+				size_t offset = object_blocks.size();
+				object_blocks.resize(offset + block_stride);
+				std::memcpy(object_blocks.data() + offset, &block, sizeof(block));
+			}
+		}
+		runs.emplace_back(end - begin);
+		begin = end;
+	}
 
-		//the object-to-light matrix is used in the next two uniforms:
-		glm::mat4x3 object_to_light = world_to_light * glm::mat4(object_to_world);
+	//Upload per-instance data (the buffer is re-specified every draw):
+	GLuint &instance_buffer = draw_scratch.instance_buffer;
+	if (!instances.empty()) {
+		if (instance_buffer == 0) glGenBuffers(1, &instance_buffer);
+		gl_state.bind_buffer(GL_ARRAY_BUFFER, instance_buffer);
+		glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(InstanceData), instances.data(), GL_STREAM_DRAW);
+	}
+
+	//Upload per-object uniform blocks (same story):
+	GLuint &object_matrices_buffer = draw_scratch.object_matrices_buffer;
+	if (!object_blocks.empty()) {
+		if (object_matrices_buffer == 0) glGenBuffers(1, &object_matrices_buffer);
+		gl_state.bind_buffer(GL_UNIFORM_BUFFER, object_matrices_buffer);
+		glBufferData(GL_UNIFORM_BUFFER, object_blocks.size(), object_blocks.data(), GL_STREAM_DRAW);
+	}
+
+	//Binds go through gl_state (which skips those that would not change any state); count them for DrawStats:
+	auto set_program = [&](GLuint program) {
+		if (gl_state.use_program(program)) stats.program_binds += 1;
+		else stats.program_binds_skipped += 1;
+	};
+	auto set_vao = [&](GLuint vao) {
+		if (gl_state.bind_vertex_array(vao)) stats.vao_binds += 1;
+		else stats.vao_binds_skipped += 1;
+	};
+	auto set_texture = [&](uint32_t i, Drawable::Pipeline::TextureInfo const &want) {
+		if (gl_state.bind_texture(i, want.target, want.texture)) stats.texture_binds += 1;
+		else if (want.texture != 0) stats.texture_binds_skipped += 1;
+	};
+
+	//Send each run to OpenGL in sorted order:
+	uint32_t item_index = 0;
+	uint32_t instance_index = 0;
+	uint32_t block_index = 0;
+	for (uint32_t run : runs) {
+		RenderItem const &item = queue[item_index];
+		item_index += run;
+
+		Scene::Drawable::Pipeline const &pipeline = item.drawable->pipeline;
 
-		//OBJECT_TO_CLIP takes vertices from object space to light space:
-		if (pipeline.OBJECT_TO_LIGHT_mat4x3 != -1U) {
-			glUniformMatrix4x3fv(pipeline.OBJECT_TO_LIGHT_mat4x3, 1, GL_FALSE, glm::value_ptr(object_to_light));
+		if (run >= 2) {
+			Scene::Drawable::Pipeline::Instanced const &instanced = pipeline.instanced;
+
+			set_program(instanced.program);
+			set_vao(instanced.vao);
+
+			if (instanced.WORLD_TO_CLIP_mat4 != -1U) {
+				glUniformMatrix4fv(instanced.WORLD_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(world_to_clip));
+				stats.uniform_uploads += 1;
+			}
+			if (instanced.WORLD_TO_LIGHT_mat4x3 != -1U) {
+				glUniformMatrix4x3fv(instanced.WORLD_TO_LIGHT_mat4x3, 1, GL_FALSE, glm::value_ptr(world_to_light));
+				stats.uniform_uploads += 1;
+			}
+
+			//point per-instance attributes at this run's part of the instance buffer:
+			// (matrix attributes occupy one location per column)
+			gl_state.bind_buffer(GL_ARRAY_BUFFER, instance_buffer);
+			GLbyte const *base = (GLbyte const *)0 + instance_index * sizeof(InstanceData);
+			auto bind_columns = [&](GLuint location, uint32_t columns, size_t offset) {
+				if (location == -1U) return;
+				for (uint32_t c = 0; c < columns; ++c) {
+					glVertexAttribPointer(location + c, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), base + offset + c * sizeof(glm::vec3));
+					glVertexAttribDivisor(location + c, 1);
+					glEnableVertexAttribArray(location + c);
+				}
+			};
+			bind_columns(instanced.OBJECT_TO_WORLD_mat4x3, 4, offsetof(InstanceData, object_to_world));
+			bind_columns(instanced.NORMAL_TO_LIGHT_mat3, 3, offsetof(InstanceData, normal_to_light));
+			instance_index += run;
+
+			for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
+				set_texture(i, pipeline.textures[i]);
+			}
+
+			if (pipeline.index_count) {
+				glDrawElementsInstancedBaseVertex(pipeline.type, pipeline.index_count, pipeline.index_type, index_offset(pipeline), run, pipeline.start);
+			} else {
+				glDrawArraysInstanced(pipeline.type, pipeline.start, pipeline.count, run);
+			}
+			stats.draw_calls += 1;
+			stats.instanced_draw_calls += 1;
+			stats.instances += run;
+			continue;
 		}
 
-		//NORMAL_TO_CLIP takes normals from object space to light space:
-		if (pipeline.NORMAL_TO_LIGHT_mat3 != -1U) {
-			glm::mat3 normal_to_light = glm::inverse(glm::transpose(glm::mat3(object_to_light)));
-			glUniformMatrix3fv(pipeline.NORMAL_TO_LIGHT_mat3, 1, GL_FALSE, glm::value_ptr(normal_to_light));
+		//Set shader program:
+		set_program(pipeline.program);
+
+		//Set attribute sources:
+		set_vao(pipeline.vao);
+
+		//Configure program uniforms:
+
+		if (pipeline.object_matrices_block) {
+			//matrices were already written to this drawable's slice of the uniform buffer:
+			gl_state.bind_buffer_range(GL_UNIFORM_BUFFER, Drawable::Pipeline::ObjectMatricesBinding, object_matrices_buffer, block_index * block_stride, sizeof(ObjectMatricesStd140));
+			block_index += 1;
+			stats.object_block_binds += 1;
+		} else {
+			//the object-to-world matrix is used in all three of these uniforms:
+			glm::mat4x3 const &object_to_world = *item.object_to_world;
+
+			//OBJECT_TO_CLIP takes vertices from object space to clip space:
+			if (pipeline.OBJECT_TO_CLIP_mat4 != -1U) {
+				glm::mat4 object_to_clip = world_to_clip * glm::mat4(object_to_world) * glm::mat4(pipeline.dequantize);
+				glUniformMatrix4fv(pipeline.OBJECT_TO_CLIP_mat4, 1, GL_FALSE, glm::value_ptr(object_to_clip));
+				stats.uniform_uploads += 1;
+			}
+
+			//the object-to-light matrix is used in the next two uniforms:
+			glm::mat4x3 object_to_light = world_to_light * glm::mat4(object_to_world);
+
+			//OBJECT_TO_CLIP takes vertices from object space to light space:
+			if (pipeline.OBJECT_TO_LIGHT_mat4x3 != -1U) {
+				glm::mat4x3 position_to_light = object_to_light * glm::mat4(pipeline.dequantize);
+				glUniformMatrix4x3fv(pipeline.OBJECT_TO_LIGHT_mat4x3, 1, GL_FALSE, glm::value_ptr(position_to_light));
+				stats.uniform_uploads += 1;
+			}
+
+			//NORMAL_TO_CLIP takes normals from object space to light space:
+			if (pipeline.NORMAL_TO_LIGHT_mat3 != -1U) {
+				glm::mat3 normal_to_light = glm::inverse(glm::transpose(glm::mat3(object_to_light)));
+				glUniformMatrix3fv(pipeline.NORMAL_TO_LIGHT_mat3, 1, GL_FALSE, glm::value_ptr(normal_to_light));
+				stats.uniform_uploads += 1;
+			}
 		}
 
 		//set any requested custom uniforms:
 		if (pipeline.set_uniforms) pipeline.set_uniforms();
 
-		//set up textures:
+		//set up textures (units the pipeline doesn't use are left empty, as before):
 		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, pipeline.textures[i].texture);
-			}
+			set_texture(i, pipeline.textures[i]);
 		}
 
 		//draw the object:
-		glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
-
-		//un-bind textures:
-		for (uint32_t i = 0; i < Drawable::Pipeline::TextureCount; ++i) {
-			if (pipeline.textures[i].texture != 0) {
-				glActiveTexture(GL_TEXTURE0 + i);
-				glBindTexture(pipeline.textures[i].target, 0);
-			}
+		if (pipeline.index_count) {
+			glDrawElementsBaseVertex(pipeline.type, pipeline.index_count, pipeline.index_type, index_offset(pipeline), pipeline.start);
+		} else {
+			glDrawArrays(pipeline.type, pipeline.start, pipeline.count);
 		}
-		glActiveTexture(GL_TEXTURE0);
-
+		stats.draw_calls += 1;
 	}
 
-	glUseProgram(0);
-	glBindVertexArray(0);
+	//(bindings are left in place -- gl_state knows about them, so the next frame's identical binds are skipped)
 
 	GL_ERRORS();
+
+	last_draw_stats = stats;
 }
 
+Scene::DrawScratch::~DrawScratch() {
+	if (instance_buffer == 0 && object_matrices_buffer == 0) return;
+	if (instance_buffer != 0) glDeleteBuffers(1, &instance_buffer);
+	if (object_matrices_buffer != 0) glDeleteBuffers(1, &object_matrices_buffer);
+	//(deleting a bound buffer unbinds it, which gl_state wouldn't otherwise know about)
+	gl_state.invalidate();
+}
 
 void Scene::load(std::string const &filename,
-	std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
+	std::function< void(Scene &, TransformHandle, std::string const &) > const &on_drawable) {
+	load_file(filename, on_drawable, nullptr, nullptr);
+}
 
-	std::ifstream file(filename, std::ios::binary);
+void Scene::load(std::string const &filename,
+	std::function< void(std::vector< std::string_view > const &, std::vector< uint32_t > *) > const &resolve_meshes,
+	std::function< void(Scene &, TransformHandle, uint32_t) > const &on_mesh) {
+	load_file(filename, nullptr, resolve_meshes, on_mesh);
+}
+
+void Scene::load_file(std::string const &filename,
+	std::function< void(Scene &, TransformHandle, std::string const &) > const &on_drawable,
+	std::function< void(std::vector< std::string_view > const &, std::vector< uint32_t > *) > const &resolve_meshes,
+	std::function< void(Scene &, TransformHandle, uint32_t) > const &on_mesh) {
+
+	//chunks are looked up by name and used in place from the mapping or pack (nothing is copied out of the file):
+	DataFile file(filename);
+	ChunkReader reader(file.data(), file.data() + file.size());
 
-	std::vector< char > names;
-	read_chunk(file, "str0", &names);
+	ChunkView< char > names = reader.find< char >("str0");
 
 	struct HierarchyEntry {
 		uint32_t parent;
@@ -183,8 +845,7 @@ void Scene::load(std::string const &filename,
 		glm::vec3 scale;
 	};
 	static_assert(sizeof(HierarchyEntry) == 4 + 4 + 4 + 4*3 + 4*4 + 4*3, "HierarchyEntry is packed.");
-	std::vector< HierarchyEntry > hierarchy;
-	read_chunk(file, "xfh0", &hierarchy);
+	ChunkView< HierarchyEntry > hierarchy = reader.find< HierarchyEntry >("xfh0");
 
 	struct MeshEntry {
 		uint32_t transform;
@@ -192,8 +853,7 @@ void Scene::load(std::string const &filename,
 		uint32_t name_end;
 	};
 	static_assert(sizeof(MeshEntry) == 4 + 4 + 4, "MeshEntry is packed.");
-	std::vector< MeshEntry > meshes;
-	read_chunk(file, "msh0", &meshes);
+	ChunkView< MeshEntry > meshes = reader.find< MeshEntry >("msh0");
 
 	struct CameraEntry {
 		uint32_t transform;
@@ -202,8 +862,7 @@ void Scene::load(std::string const &filename,
 		float clip_near, clip_far;
 	};
 	static_assert(sizeof(CameraEntry) == 4 + 4 + 4 + 4 + 4, "CameraEntry is packed.");
-	std::vector< CameraEntry > loaded_cameras;
-	read_chunk(file, "cam0", &loaded_cameras);
+	ChunkView< CameraEntry > loaded_cameras = reader.find< CameraEntry >("cam0");
 
 	struct LightEntry {
 		uint32_t transform;
@@ -214,35 +873,33 @@ void Scene::load(std::string const &filename,
 		float fov;
 	};
 	static_assert(sizeof(LightEntry) == 4 + 1 + 3 + 4 + 4 + 4, "LightEntry is packed.");
-	std::vector< LightEntry > loaded_lights;
-	read_chunk(file, "lmp0", &loaded_lights);
+	ChunkView< LightEntry > loaded_lights = reader.find< LightEntry >("lmp0");
 
 
 	//--------------------------------
 	//Now that file is loaded, create transforms for hierarchy entries:
 
-	std::vector< Transform * > hierarchy_transforms;
+	std::vector< TransformHandle > hierarchy_transforms;
 	hierarchy_transforms.reserve(hierarchy.size());
 
 	for (auto const &h : hierarchy) {
-		transforms.emplace_back();
-		Transform *t = &transforms.back();
+		TransformHandle parent;
 		if (h.parent != -1U) {
 			if (h.parent >= hierarchy_transforms.size()) {
 				throw std::runtime_error("scene file '" + filename + "' did not contain transforms in topological-sort order.");
 			}
-			t->parent = hierarchy_transforms[h.parent];
+			parent = hierarchy_transforms[h.parent];
 		}
 
-		if (h.name_begin <= h.name_end && h.name_end <= names.size()) {
-			t->name = std::string(names.begin() + h.name_begin, names.begin() + h.name_end);
-		} else {
+		if (!(h.name_begin <= h.name_end && h.name_end <= names.size())) {
 				throw std::runtime_error("scene file '" + filename + "' contains hierarchy entry with invalid name indices");
 		}
 
-		t->position = h.position;
-		t->rotation = h.rotation;
-		t->scale = h.scale;
+		//file order is already topologically sorted, so this appends to the store's packed arrays in order:
+		TransformHandle t = transforms.emplace(std::string(names.begin() + h.name_begin, names.begin() + h.name_end), parent);
+		transforms.set_position(t, h.position);
+		transforms.set_rotation(t, h.rotation);
+		transforms.set_scale(t, h.scale);
 
 		hierarchy_transforms.emplace_back(t);
 	}
@@ -255,14 +912,29 @@ void Scene::load(std::string const &filename,
 		if (!(m.name_begin <= m.name_end && m.name_end <= names.size())) {
 			throw std::runtime_error("scene file '" + filename + "' contains mesh entry with invalid name indices");
 		}
-		std::string name = std::string(names.begin() + m.name_begin, names.begin() + m.name_end);
-
 		if (on_drawable) {
+			std::string name = std::string(names.begin() + m.name_begin, names.begin() + m.name_end);
 			on_drawable(*this, hierarchy_transforms[m.transform], name);
 		}
 
 	}
 
+	if (resolve_meshes) {
+		std::vector< std::string_view > mesh_names;
+		mesh_names.reserve(meshes.size());
+		for (auto const &m : meshes) {
+			mesh_names.emplace_back(names.data() + m.name_begin, m.name_end - m.name_begin);
+		}
+		std::vector< uint32_t > mesh_ids;
+		resolve_meshes(mesh_names, &mesh_ids);
+		if (mesh_ids.size() != meshes.size()) {
+			throw std::runtime_error("resolving meshes from scene file '" + filename + "' produced the wrong number of ids");
+		}
+		for (uint32_t i = 0; i < meshes.size(); ++i) {
+			if (on_mesh) on_mesh(*this, hierarchy_transforms[meshes[i].transform], mesh_ids[i]);
+		}
+	}
+
 	for (auto const &c : loaded_cameras) {
 		if (c.transform >= hierarchy_transforms.size()) {
 			throw std::runtime_error("scene file '" + filename + "' contains camera entry with invalid transform index (" + std::to_string(c.transform) + ")");
@@ -271,8 +943,7 @@ void Scene::load(std::string const &filename,
 			std::cout << "Ignoring non-perspective camera (" + std::string(c.type, 4) + ") stored in file." << std::endl;
 			continue;
 		}
-		cameras.emplace_back(hierarchy_transforms[c.transform]);
-		Camera *camera = &cameras.back();
+		Camera *camera = &cameras[cameras.emplace(hierarchy_transforms[c.transform])];
 		camera->fovy = c.data / 180.0f * 3.1415926f; //FOV is stored in degrees; convert to radians.
 		camera->near = c.clip_near;
 		//N.b. far plane is ignored because cameras use infinite perspective matrices.
@@ -294,17 +965,18 @@ void Scene::load(std::string const &filename,
 			std::cout << "Ignoring unrecognized lamp type (" + std::string(&l.type, 1) + ") stored in file." << std::endl;
 			continue;
 		}
-		lights.emplace_back(hierarchy_transforms[l.transform]);
-		Light *light = &lights.back();
+		Light *light = &lights[lights.emplace(hierarchy_transforms[l.transform])];
 		light->type = static_cast<Light::Type>(l.type);
 		light->energy = glm::vec3(l.color) / 255.0f * l.energy;
 		light->spot_fov = l.fov / 180.0f * 3.1415926f; //FOV is stored in degrees; convert to radians.
 	}
 
 	//load any extra that a subclass wants:
-	load_extra(file, names, hierarchy_transforms);
+	load_extra(reader, names, hierarchy_transforms);
+
+	index_names();
 
-	if (file.peek() != EOF) {
+	if (reader.trailing() != 0) {
 		std::cerr << "WARNING: trailing data in scene file '" << filename << "'" << std::endl;
 	}
 
@@ -314,7 +986,7 @@ void Scene::load(std::string const &filename,
 
 //-------------------------
 
-Scene::Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable) {
+Scene::Scene(std::string const &filename, std::function< void(Scene &, TransformHandle, std::string const &) > const &on_drawable) {
 	load(filename, on_drawable);
 }
 
@@ -327,51 +999,56 @@ Scene &Scene::operator=(Scene const &other) {
 	return *this;
 }
 
-void Scene::set(Scene const &other, std::unordered_map< Transform const *, Transform * > *transform_map_) {
+void Scene::set(Scene const &other) {
+	if (&other == this) return;
 
-	std::unordered_map< Transform const *, Transform * > t2t_temp;
-	std::unordered_map< Transform const *, Transform * > &transform_to_transform = *(transform_map_ ? transform_map_ : &t2t_temp);
-
-	transform_to_transform.clear();
-
-	//null transform maps to itself:
-	transform_to_transform.insert(std::make_pair(nullptr, nullptr));
-
-	//Copy transforms and store mapping:
-	transforms.clear();
-	for (auto const &t : other.transforms) {
-		transforms.emplace_back();
-		transforms.back().name = t.name;
-		transforms.back().position = t.position;
-		transforms.back().rotation = t.rotation;
-		transforms.back().scale = t.scale;
-		transforms.back().parent = t.parent; //will update later
+	//everything is stored by value in flat arrays (transform parents are indices), so handles stay valid across the copy:
+	// (names are atoms in a name table that the copy shares)
+	transforms = other.transforms;
+	drawables = other.drawables;
+	cameras = other.cameras;
+	lights = other.lights;
+	//(the copied pools still point at other's transforms; the attachment counts were copied along with 'transforms')
+	drawables.attached_to = &transforms;
+	cameras.attached_to = &transforms;
+	lights.attached_to = &transforms;
+	transforms_by_name = other.transforms_by_name;
+	drawables_by_name = other.drawables_by_name;
+}
 
-		//store mapping between transforms old and new:
-		auto ret = transform_to_transform.insert(std::make_pair(&t, &transforms.back()));
-		assert(ret.second);
-	}
+Scene::TransformHandle Scene::find_transform(std::string const &name) const {
+	uint32_t atom = transforms.name_table->find(name);
+	if (atom >= transforms_by_name.size()) return TransformHandle();
+	TransformHandle transform = transforms_by_name[atom];
+	if (!transforms.contains(transform) || transforms.get_name_atom(transform) != atom) return TransformHandle();
+	return transform;
+}
 
-	//update transform parents:
-	for (auto &t : transforms) {
-		t.parent = transform_to_transform.at(t.parent);
-	}
+Scene::DrawableHandle Scene::find_drawable(std::string const &name) const {
+	uint32_t atom = transforms.name_table->find(name);
+	if (atom >= drawables_by_name.size()) return DrawableHandle();
+	DrawableHandle drawable = drawables_by_name[atom];
+	if (!drawables.contains(drawable)) return DrawableHandle();
+	TransformHandle transform = drawables[drawable].transform;
+	if (!transforms.contains(transform) || transforms.get_name_atom(transform) != atom) return DrawableHandle();
+	return drawable;
+}
 
-	//copy other's drawables, updating transform pointers:
-	drawables = other.drawables;
-	for (auto &d : drawables) {
-		d.transform = transform_to_transform.at(d.transform);
-	}
+void Scene::index_names() {
+	transforms_by_name.assign(transforms.name_table->size(), TransformHandle());
+	drawables_by_name.assign(transforms.name_table->size(), DrawableHandle());
 
-	//copy other's cameras, updating transform pointers:
-	cameras = other.cameras;
-	for (auto &c : cameras) {
-		c.transform = transform_to_transform.at(c.transform);
+	//first in store (parent-before-child) order wins:
+	for (uint32_t i = 0; i < transforms.size(); ++i) {
+		if (!transforms.alive(i)) continue;
+		TransformHandle &slot = transforms_by_name[transforms.name_atoms[i]];
+		if (!slot) slot = transforms.handle(i);
 	}
-
-	//copy other's lights, updating transform pointers:
-	lights = other.lights;
-	for (auto &l : lights) {
-		l.transform = transform_to_transform.at(l.transform);
+	//first in pool order wins:
+	for (uint32_t d = 0; d < drawables.size(); ++d) {
+		TransformHandle transform = drawables.packed[d].transform;
+		if (!transforms.contains(transform)) continue;
+		DrawableHandle &slot = drawables_by_name[transforms.get_name_atom(transform)];
+		if (!slot) slot = drawables.handle(d);
 	}
 }
@@ -1,9 +1,9 @@
 #pragma once
 
 /*
- * A scene manages a hierarchical arrangement of transformations (via "Transform").
+ * A scene manages a hierarchical arrangement of transformations (via "TransformStore").
  *
- * Each transformation may have associated:
+ * Transforms are referred to by TransformHandle, and each may have associated:
  *  - Drawing data (via "Drawable")
  *  - Camera information (via "Camera")
  *  - Light information (via "Light")
@@ -15,44 +15,313 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
-#include <list>
+#include <deque>
+#include <limits>
 #include <memory>
 #include <functional>
 #include <string>
-#include <vector>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
+#include <utility>
+#include <cassert>
+
+struct WorkerPool; //(see WorkerPool.hpp)
+struct ChunkReader; //(see read_write_chunk.hpp)
+template< typename T > struct ChunkView;
 
 struct Scene {
-	struct Transform {
-		//Transform names are useful for debugging and looking up locations in a loaded scene:
-		std::string name;
+	//Handles are stable references to objects that live in one of the scene's packed arrays:
+	// - a handle keeps referring to the same object as the arrays are re-sorted or compacted;
+	// - a handle to an erased object is detected as stale (its slot's generation will have moved on).
+	template< typename Tag >
+	struct Handle {
+		uint32_t slot;
+		uint32_t generation;
+
+		Handle() : slot(-1U), generation(0) { } //(null handle)
+		Handle(uint32_t slot_, uint32_t generation_) : slot(slot_), generation(generation_) { }
+
+		explicit operator bool() const { return slot != -1U; }
+		bool operator==(Handle const &other) const { return slot == other.slot && generation == other.generation; }
+		bool operator!=(Handle const &other) const { return !(*this == other); }
+	};
+
+	//Slots map handles to indices in a packed array; erased slots are recycled through a free list:
+	struct Slots {
+		struct Slot {
+			uint32_t index = -1U; //index in packed array (-1U if slot is free)
+			uint32_t generation = 0; //bumped every time the slot is freed
+		};
+		std::vector< Slot > slots;
+		std::vector< uint32_t > free_list;
+
+		//claim a slot for the object at 'index':
+		template< typename Tag >
+		Handle< Tag > allocate(uint32_t index) {
+			Handle< Tag > handle;
+			if (!free_list.empty()) {
+				handle.slot = free_list.back();
+				free_list.pop_back();
+			} else {
+				handle.slot = uint32_t(slots.size());
+				slots.emplace_back();
+			}
+			slots[handle.slot].index = index;
+			handle.generation = slots[handle.slot].generation;
+			return handle;
+		}
+		//index of the object referred to by handle (or -1U if the handle is stale):
+		template< typename Tag >
+		uint32_t find(Handle< Tag > const &handle) const {
+			if (handle.slot >= slots.size()) return -1U;
+			Slot const &s = slots[handle.slot];
+			if (s.generation != handle.generation) return -1U;
+			return s.index;
+		}
+		//release a slot (any outstanding handles to it become stale):
+		void release(uint32_t slot) {
+			assert(slot < slots.size() && slots[slot].index != -1U);
+			slots[slot].index = -1U;
+			slots[slot].generation += 1;
+			free_list.emplace_back(slot);
+		}
+		//release every slot still in use (as by release(), so handles from before stay stale after the slots are reused):
+		void release_all() {
+			for (uint32_t slot = 0; slot < slots.size(); ++slot) {
+				if (slots[slot].index != -1U) release(slot);
+			}
+		}
+	};
+
+	struct TransformStore;
+	using TransformHandle = Handle< TransformStore >;
+
+	//A Pool keeps objects packed for iteration while handing out stable handles:
+	// - emplace/erase are O(1) (erase moves the last object into the hole);
+	// - iteration (begin/end) visits a dense array, in no particular order;
+	// - a pool made with a TransformStore attaches each object to the transform it refers to ('transform') while it is in the pool,
+	//    so the store can refuse to erase transforms that are still in use. (so don't change an object's transform once it is added)
+	template< typename T >
+	struct Pool {
+		using Handle = Scene::Handle< T >;
+
+		Pool(TransformStore *attached_to_ = nullptr) : attached_to(attached_to_) { }
+
+		template< typename... Args >
+		Handle emplace(Args&&... args) {
+			uint32_t i = uint32_t(packed.size());
+			packed.emplace_back(std::forward< Args >(args)...);
+			if (attached_to) attached_to->attach(packed.back().transform);
+			Handle handle = slots.allocate< T >(i);
+			index_slots.emplace_back(handle.slot);
+			return handle;
+		}
+		void erase(Handle handle) {
+			uint32_t i = index(handle);
+			if (attached_to) attached_to->detach(packed[i].transform);
+			uint32_t last = uint32_t(packed.size()) - 1;
+			if (i != last) {
+				packed[i] = std::move(packed[last]);
+				index_slots[i] = index_slots[last];
+				slots.slots[index_slots[i]].index = i;
+			}
+			packed.pop_back();
+			index_slots.pop_back();
+			slots.release(handle.slot);
+		}
+		void clear() {
+			if (attached_to) {
+				for (T const &object : packed) attached_to->detach(object.transform);
+			}
+			packed.clear();
+			index_slots.clear();
+			slots.release_all();
+		}
+		//reserve space so that the next 'count' emplace() calls don't reallocate:
+		void reserve(size_t count) {
+			packed.reserve(count);
+			index_slots.reserve(count);
+			slots.slots.reserve(count);
+		}
+
+		bool contains(Handle handle) const { return slots.find(handle) != -1U; }
+		uint32_t index(Handle handle) const {
+			uint32_t i = slots.find(handle);
+			assert(i != -1U && "handle should refer to a live object");
+			return i;
+		}
+		Handle handle(uint32_t index) const { return Handle(index_slots[index], slots.slots[index_slots[index]].generation); }
+
+		T &operator[](Handle handle) { return packed[index(handle)]; }
+		T const &operator[](Handle handle) const { return packed[index(handle)]; }
+
+		size_t size() const { return packed.size(); }
+		bool empty() const { return packed.empty(); }
+		typename std::vector< T >::iterator begin() { return packed.begin(); }
+		typename std::vector< T >::iterator end() { return packed.end(); }
+		typename std::vector< T >::const_iterator begin() const { return packed.begin(); }
+		typename std::vector< T >::const_iterator end() const { return packed.end(); }
+
+		//--- internals ---
+		std::vector< T > packed;
+		std::vector< uint32_t > index_slots; //slot that refers to each packed index
+		Slots slots;
+		TransformStore *attached_to = nullptr; //(see above)
+	};
+
+	//Names are interned in a NameTable: each distinct string is stored once and referred to by a small integer "atom".
+	// Tables only grow, so atoms stay valid; copies of a scene share (and keep adding to) the same table.
+	// (NOTE: interning isn't thread-safe, so don't name objects in scenes that share a table from different threads)
+	struct NameTable {
+		NameTable(); //(atom 0 is the empty string)
+		NameTable(NameTable const &) = delete; //(share tables via shared_ptr instead)
+		NameTable &operator=(NameTable const &) = delete;
+
+		uint32_t intern(std::string_view name); //atom for 'name', adding it if needed
+		uint32_t find(std::string_view name) const; //atom for 'name', or -1U if it was never interned
+		std::string const &get(uint32_t atom) const { return strings[atom]; }
+		uint32_t size() const { return uint32_t(strings.size()); }
+
+		//--- internals ---
+		std::deque< std::string > strings; //(a deque, so strings never move and 'atoms' can refer to their characters)
+		std::unordered_map< std::string_view, uint32_t > atoms;
+	};
+
+	//Transforms are stored as parallel arrays in a TransformStore and referred to via TransformHandle:
+	// (large stores can spread update() over a WorkerPool)
+	struct TransformStore {
+		//Create a new transform (optionally as a child of 'parent'):
+		TransformHandle emplace(std::string const &name = "", TransformHandle parent = TransformHandle());
+		//Remove a transform; any children it has become roots:
+		// throws if drawables, cameras, or lights still refer to it (erase those first)
+		void erase(TransformHandle transform);
+		//Remove everything (throws, like erase, if anything still refers to a transform):
+		void clear();
+
+		//does the handle refer to a live transform?
+		bool contains(TransformHandle transform) const { return slots.find(transform) != -1U; }
+
+		//Live transform count:
+		uint32_t count() const { return uint32_t(parents.size()) - dead_count; }
+
+		//Transforms can also be visited by index (in parent-before-child order):
+		// for (uint32_t i = 0; i < store.size(); ++i) { if (!store.alive(i)) continue; ... store.handle(i) ... }
+		uint32_t size() const { return uint32_t(parents.size()); }
+		bool alive(uint32_t index) const { return !(flags[index] & FlagDead); }
+		TransformHandle handle(uint32_t index) const { return TransformHandle{ index_slots[index], slots.slots[index_slots[index]].generation }; }
+		uint32_t index(TransformHandle transform) const {
+			uint32_t i = slots.find(transform);
+			assert(i != -1U && "transform handle should refer to a live transform");
+			return i;
+		}
 
 		//The core function of a transform is to store a transformation in the world:
-		glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f);
-		glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f); //n.b. wxyz init order
-		glm::vec3 scale = glm::vec3(1.0f, 1.0f, 1.0f);
+		glm::vec3 const &get_position(TransformHandle transform) const { return positions[index(transform)]; }
+		glm::quat const &get_rotation(TransformHandle transform) const { return rotations[index(transform)]; }
+		glm::vec3 const &get_scale(TransformHandle transform) const { return scales[index(transform)]; }
+		void set_position(TransformHandle transform, glm::vec3 const &position) { uint32_t i = index(transform); positions[i] = position; mark_dirty(i); }
+		void set_rotation(TransformHandle transform, glm::quat const &rotation) { uint32_t i = index(transform); rotations[i] = rotation; mark_dirty(i); }
+		void set_scale(TransformHandle transform, glm::vec3 const &scale) { uint32_t i = index(transform); scales[i] = scale; mark_dirty(i); }
 
 		//The transform above may be relative to some parent transform:
-		Transform *parent = nullptr;
+		TransformHandle get_parent(TransformHandle transform) const {
+			uint32_t p = parents[index(transform)];
+			return (p == -1U || !alive(p) ? TransformHandle() : handle(p));
+		}
+		//n.b. re-sorts the store if the new parent comes after the child:
+		void set_parent(TransformHandle transform, TransformHandle parent);
+
+		//Transform names are useful for debugging and looking up locations in a loaded scene:
+		// (names are stored as atoms in name_table)
+		std::string const &get_name(TransformHandle transform) const { return name_table->get(name_atoms[index(transform)]); }
+		void set_name(TransformHandle transform, std::string const &name) { name_atoms[index(transform)] = name_table->intern(name); }
+		uint32_t get_name_atom(TransformHandle transform) const { return name_atoms[index(transform)]; }
 
 		//It is often convenient to construct matrices representing this transformation:
 		// ..relative to its parent:
-		glm::mat4x3 make_local_to_parent() const;
-		glm::mat4x3 make_parent_to_local() const;
-		// ..relative to the world:
-		glm::mat4x3 make_local_to_world() const;
-		glm::mat4x3 make_world_to_local() const;
-
-		//since hierarchy is tracked through pointers, copy-constructing a transform  is not advised:
-		Transform(Transform const &) = delete;
-		//if we delete some constructors, we need to let the compiler know that the default constructor is still okay:
-		Transform() = default;
+		glm::mat4x3 make_local_to_parent(TransformHandle transform) const;
+		glm::mat4x3 make_parent_to_local(TransformHandle transform) const;
+		// ..relative to the world (cached; brings the cache up to date first):
+		glm::mat4x3 const &get_local_to_world(TransformHandle transform) const;
+		glm::mat4x3 const &get_world_to_local(TransformHandle transform) const;
+
+		//Bring every cached local_to_world matrix up to date:
+		// one pass over the packed arrays that only does matrix math for transforms that changed (or whose ancestors changed).
+		// Stores with ParallelThreshold or more transforms are instead updated one hierarchy level at a time,
+		//  with each level split into chunks across a WorkerPool (WorkerPool::shared() by default);
+		//  results are identical no matter how many threads are used.
+		void update() const;
+		void update(WorkerPool &workers) const;
+		enum : uint32_t { ParallelThreshold = 16384 };
+
+		//--- internals ---
+
+		//per-transform data, in parallel arrays sorted so that parents come before their children:
+		std::vector< glm::vec3 > positions;
+		std::vector< glm::quat > rotations;
+		std::vector< glm::vec3 > scales;
+		std::vector< uint32_t > parents; //index of parent, or -1U for roots
+		std::vector< uint32_t > name_atoms; //(atoms in name_table)
+		std::vector< uint32_t > index_slots; //slot (in 'slots') that refers to each index
+
+		std::shared_ptr< NameTable > name_table = std::make_shared< NameTable >(); //(shared with copies of this store)
+
+		enum : uint8_t {
+			FlagDead = 0x1, //transform has been erased; will be dropped at next compaction
+			FlagDirty = 0x2, //local parameters changed since local_to_world was computed
+			FlagWorldToLocalStale = 0x4, //world_to_local needs to be recomputed
+		};
+		mutable std::vector< uint8_t > flags;
+
+		//cached matrices:
+		mutable std::vector< glm::mat4x3 > local_to_worlds;
+		mutable std::vector< glm::mat4x3 > world_to_locals;
+		mutable uint32_t first_dirty = -1U; //lowest index changed since the last update() (-1U if none); nothing before it needs work
+
+		//indices grouped by depth in the hierarchy (level 'd' is level_order[level_starts[d]] .. level_order[level_starts[d+1]-1]):
+		// (rebuilt by the parallel update path when the hierarchy has changed)
+		mutable std::vector< uint32_t > level_order;
+		mutable std::vector< uint32_t > level_starts;
+		mutable bool levels_stale = true;
+		void build_levels() const;
+
+		Slots slots;
+		uint32_t dead_count = 0;
+
+		//how many pooled objects refer to each transform, by slot (see Pool):
+		std::vector< uint32_t > attached;
+		void attach(TransformHandle transform) {
+			assert(contains(transform) && "objects should refer to a live transform");
+			attached[transform.slot] += 1;
+		}
+		void detach(TransformHandle transform) {
+			assert(transform.slot < attached.size() && attached[transform.slot] > 0);
+			attached[transform.slot] -= 1;
+		}
+
+		void mark_dirty(uint32_t i) {
+			flags[i] |= FlagDirty;
+			if (i < first_dirty) first_dirty = i;
+		}
+		//drop erased transforms (preserving order):
+		void compact();
+		//re-establish parent-before-child order:
+		void sort();
 	};
 
+	struct Drawable;
+	using DrawableHandle = Pool< Drawable >::Handle;
+
 	struct Drawable {
 		//a 'Drawable' attaches attribute data to a transform:
-		Drawable(Transform *transform_) : transform(transform_) { assert(transform); }
-		Transform * transform;
+		Drawable(TransformHandle transform_) : transform(transform_) { assert(transform); }
+		TransformHandle transform;
+
+		//(optional) local-space bounding box -- e.g., copied from Mesh::min / Mesh::max -- used by draw() to skip off-screen drawables:
+		// (an empty box, as by default, means "never cull")
+		glm::vec3 bbox_min = glm::vec3( std::numeric_limits< float >::infinity());
+		glm::vec3 bbox_max = glm::vec3(-std::numeric_limits< float >::infinity());
 
 		//Contains all the data needed to run the OpenGL pipeline:
 		struct Pipeline {
@@ -65,11 +334,29 @@ struct Scene {
 			GLuint start = 0; //first vertex to draw; passed to glDrawArrays
 			GLuint count = 0; //number of vertices to draw; passed to glDrawArrays
 
+			//indexed meshes (index_count > 0) are drawn with glDrawElementsBaseVertex instead, using 'start' as the base vertex:
+			// (the vao must have the element array buffer bound -- MeshBuffer::make_vao_for_program does this)
+			GLenum index_type = GL_UNSIGNED_INT; //type of indices in the element array
+			GLuint index_start = 0; //first index to draw
+			GLuint index_count = 0; //number of indices to draw (0 => draw vertices with glDrawArrays)
+
+			//takes the vertex Position attribute to object space (see Mesh::dequantize -- identity unless the mesh is quantized):
+			// draw() folds this into the position matrices (OBJECT_TO_CLIP, OBJECT_TO_LIGHT, and instanced OBJECT_TO_WORLD),
+			// but not NORMAL_TO_LIGHT, so programs draw quantized meshes without any changes
+			glm::mat4x3 dequantize = glm::mat4x3(1.0f);
+
 			//uniforms:
 			GLuint OBJECT_TO_CLIP_mat4 = -1U; //uniform location for object to clip space matrix
 			GLuint OBJECT_TO_LIGHT_mat4x3 = -1U; //uniform location for object to light space (== world space) matrix
 			GLuint NORMAL_TO_LIGHT_mat3 = -1U; //uniform location for normal to light space (== world space) matrix
 
+			//..or, instead of the three uniforms above, per-object matrices can come from a std140 uniform block:
+			// uniform ObjectMatrices { mat4 OBJECT_TO_CLIP; mat4x3 OBJECT_TO_LIGHT; mat3 NORMAL_TO_LIGHT; };
+			// (the program should bind that block to ObjectMatricesBinding; draw() writes every such drawable's matrices
+			//  into one uniform buffer per frame and selects each drawable's slice with glBindBufferRange)
+			enum : GLuint { ObjectMatricesBinding = 0 };
+			bool object_matrices_block = false;
+
 			std::function< void() > set_uniforms; //(optional) function to set any other useful uniforms
 
 			//texture objects to bind for the first TextureCount textures:
@@ -78,13 +365,32 @@ struct Scene {
 				GLuint texture = 0;
 				GLenum target = GL_TEXTURE_2D;
 			} textures[TextureCount];
+
+			//(optional) instanced variant of this pipeline:
+			// runs of drawables (in draw order) that share all of the state above and have no set_uniforms
+			// are drawn with a single glDrawArraysInstanced call, with per-instance matrices read from an instance buffer:
+			struct Instanced {
+				GLuint program = 0; //instanced version of 'program' (0 => never draw instanced)
+				GLuint vao = 0; //mesh attribs for 'program'; per-instance attribs are pointed at the instance buffer by Scene::draw
+
+				//per-instance attributes:
+				GLuint OBJECT_TO_WORLD_mat4x3 = -1U; //attribute location (four consecutive vec3 locations)
+				GLuint NORMAL_TO_LIGHT_mat3 = -1U; //attribute location (three consecutive vec3 locations)
+
+				//uniforms:
+				GLuint WORLD_TO_CLIP_mat4 = -1U; //uniform location for world to clip space matrix
+				GLuint WORLD_TO_LIGHT_mat4x3 = -1U; //uniform location for world to light space matrix
+			} instanced;
 		} pipeline;
 	};
 
+	struct Camera;
+	using CameraHandle = Pool< Camera >::Handle;
+
 	struct Camera {
 		//a 'Camera' attaches camera data to a transform:
-		Camera(Transform *transform_) : transform(transform_) { assert(transform); }
-		Transform * transform;
+		Camera(TransformHandle transform_) : transform(transform_) { assert(transform); }
+		TransformHandle transform;
 		//NOTE: cameras are directed along their -z axis
 
 		//perspective camera parameters:
@@ -95,10 +401,13 @@ struct Scene {
 		glm::mat4 make_projection() const;
 	};
 
+	struct Light;
+	using LightHandle = Pool< Light >::Handle;
+
 	struct Light {
 		//a 'Light' attaches light data to a transform:
-		Light(Transform *transform_) : transform(transform_) { assert(transform); }
-		Transform * transform;
+		Light(TransformHandle transform_) : transform(transform_) { assert(transform); }
+		TransformHandle transform;
 		//NOTE: directional, spot, and hemisphere lights are directed along their -z axis
 
 		enum Type : char {
@@ -117,37 +426,117 @@ struct Scene {
 	};
 
 	//Scenes, of course, may have many of the above objects:
-	std::list< Transform > transforms;
-	std::list< Drawable > drawables;
-	std::list< Camera > cameras;
-	std::list< Light > lights;
+	TransformStore transforms;
+	//(drawables, cameras, and lights are attached to their transforms, which can't be erased until they are)
+	Pool< Drawable > drawables{&transforms};
+	Pool< Camera > cameras{&transforms};
+	Pool< Light > lights{&transforms};
+
+	//Look up the first transform (or drawable, by its transform's name) with a given name; returns a null handle if there isn't one:
+	// O(1), using an index that load() builds; call index_names() to include objects added or renamed since.
+	// (lookups double-check the index, so objects erased or renamed since it was built are never returned)
+	TransformHandle find_transform(std::string const &name) const;
+	DrawableHandle find_drawable(std::string const &name) const;
+	void index_names();
+
+	//name index, by atom in transforms.name_table:
+	std::vector< TransformHandle > transforms_by_name;
+	std::vector< DrawableHandle > drawables_by_name;
 
 	//The "draw" function provides a convenient way to pass all the things in a scene to OpenGL:
+	// (camera must be one of this scene's cameras)
 	void draw(Camera const &camera) const;
 
 	//..sometimes, you want to draw with a custom projection matrix and/or light space:
 	void draw(glm::mat4 const &world_to_clip, glm::mat4x3 const &world_to_light = glm::mat4x3(1.0f)) const;
 
+	//draw() culls drawables whose bounding boxes are outside the view frustum,
+	// submits the rest sorted by (program, vertex array, texture, mesh, depth), skips binds that would not change any state,
+	// and draws runs of identical instanceable drawables with one call. It records what it did (and what it was able to skip) here:
+	struct DrawStats {
+		uint32_t drawables_culled = 0, drawables_cull_tested = 0; //(drawables without a bounding box are not tested)
+		uint32_t draw_calls = 0; //(includes instanced draw calls)
+		uint32_t uniform_uploads = 0, object_block_binds = 0; //glUniform* calls for matrices, glBindBufferRange calls for ObjectMatrices
+		uint32_t instanced_draw_calls = 0, instances = 0;
+		uint32_t program_binds = 0, program_binds_skipped = 0;
+		uint32_t vao_binds = 0, vao_binds_skipped = 0;
+		uint32_t texture_binds = 0, texture_binds_skipped = 0;
+	};
+	mutable DrawStats last_draw_stats;
+
+	//draw()'s working storage, kept between calls so drawing doesn't re-allocate every frame:
+	// (never copied along with a scene; the GL buffers are made on first draw and deleted with the scene,
+	//  so a scene that has been drawn must be destroyed before the GL context is -- see the teardown in main.cpp)
+	struct DrawScratch {
+		struct RenderItem {
+			uint64_t key;
+			Drawable const *drawable;
+			glm::mat4x3 const *object_to_world;
+		};
+		std::vector< RenderItem > queue, sort_scratch;
+
+		//drawables with bounding boxes, held back for frustum culling, with their world-space boxes (center and half-extent) as parallel arrays:
+		std::vector< RenderItem > cull_items;
+		std::vector< float > cull_cx, cull_cy, cull_cz, cull_ex, cull_ey, cull_ez;
+		std::vector< uint8_t > cull_inside;
+
+		struct InstanceData {
+			glm::mat4x3 object_to_world;
+			glm::mat3 normal_to_light;
+		};
+		std::vector< uint32_t > runs; //length of each run, in queue order
+		std::vector< InstanceData > instances;
+		std::vector< uint8_t > object_blocks; //ObjectMatrices uniform block contents, block_stride bytes apart
+
+		GLsizeiptr block_stride = 0; //(0 until the first draw)
+		GLuint instance_buffer = 0;
+		GLuint object_matrices_buffer = 0;
+
+		DrawScratch() = default;
+		DrawScratch(DrawScratch const &) { }
+		DrawScratch &operator=(DrawScratch const &) { return *this; }
+		~DrawScratch();
+	};
+	mutable DrawScratch draw_scratch;
+
 	//add transforms/objects/cameras from a scene file to this scene:
 	// the 'on_drawable' callback gives your code a chance to look up mesh data and make Drawables:
 	// throws on file format errors
 	void load(std::string const &filename,
-		std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable = nullptr
+		std::function< void(Scene &, TransformHandle, std::string const &) > const &on_drawable = nullptr
+	);
+
+	//..or resolve every mesh name in the file with one call (e.g., to MeshBuffer::resolve), and get each mesh entry's resolved id:
+	// (names point into the file, so they are only valid during the call; unresolved names should get id -1U)
+	void load(std::string const &filename,
+		std::function< void(std::vector< std::string_view > const &names, std::vector< uint32_t > *ids) > const &resolve_meshes,
+		std::function< void(Scene &, TransformHandle, uint32_t mesh_id) > const &on_mesh
 	);
 
 	//this function is called to read extra chunks from the scene file after the main chunks are read:
 	// this is useful if you, e.g., subclassing scene to represent a game level/area
-	virtual void load_extra(std::istream &from, std::vector< char > const &str0, std::vector< Transform * > const &xfh0) { }
+	// (look chunks up by name with from.find< T >("magic"), or check for optional ones with from.lookup)
+	virtual void load_extra(ChunkReader &from, ChunkView< char > const &str0, std::vector< TransformHandle > const &xfh0) { }
+
+	//(both load() variants share this)
+	void load_file(std::string const &filename,
+		std::function< void(Scene &, TransformHandle, std::string const &) > const &on_drawable,
+		std::function< void(std::vector< std::string_view > const &, std::vector< uint32_t > *) > const &resolve_meshes,
+		std::function< void(Scene &, TransformHandle, uint32_t) > const &on_mesh
+	);
 
 	//empty scene:
 	Scene() = default;
 
 	//load a scene:
-	Scene(std::string const &filename, std::function< void(Scene &, Transform *, std::string const &) > const &on_drawable);
+	Scene(std::string const &filename, std::function< void(Scene &, TransformHandle, std::string const &) > const &on_drawable);
 
-	//copy a scene (with proper pointer fixup):
+	//copy a scene:
+	// every part of a scene is a set of flat arrays (with parents stored as indices), so copying is a handful of vector copies
+	//  -- no per-object allocation or pointer remapping -- and reuses this scene's existing storage where it can.
+	// (handles are copied along with the objects, so a handle into 'other' refers to the same object in the copy)
 	Scene(Scene const &); //...as a constructor
 	Scene &operator=(Scene const &); //...as scene = scene
-	//... as a set() function that optionally returns the transform->transform mapping:
-	void set(Scene const &, std::unordered_map< Transform const *, Transform * > *transform_map = nullptr);
+	//... as a set() function:
+	void set(Scene const &);
 };
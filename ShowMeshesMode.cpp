@@ -2,7 +2,9 @@
 
 #include "ShowMeshesProgram.hpp"
 #include "DrawLines.hpp"
+#include "gl_state.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 ShowMeshesMode::ShowMeshesMode(MeshBuffer const &buffer_) : buffer(buffer_) {
@@ -10,17 +12,15 @@ ShowMeshesMode::ShowMeshesMode(MeshBuffer const &buffer_) : buffer(buffer_) {
 
 	//Set up scene:
 	{ //create a single camera:
-		scene.transforms.emplace_back();
-		scene.cameras.emplace_back(&scene.transforms.back());
-		scene_camera = &scene.cameras.back();
+		//(only camera in the scene, so this reference stays put)
+		scene_camera = &scene.cameras[scene.cameras.emplace(scene.transforms.emplace("camera"))];
 		scene_camera->fovy = 60.0f / 180.0f * 3.1415926f;
 		scene_camera->near = 0.01f;
 		//scene_camera->transform and scene_camera->aspect will be set in draw()
 	}
 	{ //create a drawable to hold the current mesh:
-		scene.transforms.emplace_back();
-		scene.drawables.emplace_back(&scene.transforms.back());
-		scene_drawable = &scene.drawables.back();
+		//(only drawable in the scene, so this reference stays put)
+		scene_drawable = &scene.drawables[scene.drawables.emplace(scene.transforms.emplace("mesh"))];
 
 		scene_drawable->pipeline = show_meshes_program_pipeline;
 		scene_drawable->pipeline.vao = vao;
@@ -30,11 +30,33 @@ ShowMeshesMode::ShowMeshesMode(MeshBuffer const &buffer_) : buffer(buffer_) {
 		scene_drawable->pipeline.count = 0;
 	}
 
+	//(buffers loaded in the background get listed by update() once they are ready)
+	if (buffer.ready()) list_meshes();
+}
+
+ShowMeshesMode::~ShowMeshesMode() {
+}
+
+void ShowMeshesMode::list_meshes() {
+	//meshes are browsed in order of name:
+	mesh_order.resize(buffer.mesh_count());
+	for (uint32_t id = 0; id < mesh_order.size(); ++id) mesh_order[id] = id;
+	std::sort(mesh_order.begin(), mesh_order.end(), [this](uint32_t a, uint32_t b) {
+		return buffer.get_name(a) < buffer.get_name(b);
+	});
+	listed = true;
+
 	//select first mesh in buffer:
 	select_prev_mesh();
 }
 
-ShowMeshesMode::~ShowMeshesMode() {
+void ShowMeshesMode::update(float elapsed) {
+	if (buffer.failed()) {
+		//(upload_pending() already printed why)
+		Mode::set_current(nullptr);
+		return;
+	}
+	if (!listed && buffer.ready()) list_meshes();
 }
 
 bool ShowMeshesMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_size) {
@@ -69,7 +91,7 @@ bool ShowMeshesMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window
 			if (SDL_GetModState() & KMOD_SHIFT) {
 				//shift: pan
 
-				glm::mat3 frame = glm::mat3_cast(scene_camera->transform->rotation);
+				glm::mat3 frame = glm::mat3_cast(scene.transforms.get_rotation(scene_camera->transform));
 				camera.target -= frame[0] * (delta.x * camera.radius) + frame[1] * (delta.y * camera.radius);
 			} else {
 				//no shift: tumble
@@ -104,26 +126,27 @@ bool ShowMeshesMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window
 void ShowMeshesMode::draw(glm::uvec2 const &drawable_size) {
 	//--- use camera structure to set up scene camera ---
 
-	scene_camera->transform->rotation =
+	glm::quat rotation =
 		glm::angleAxis(camera.azimuth, glm::vec3(0.0f, 0.0f, 1.0f))
 		* glm::angleAxis(0.5f * 3.1415926f + -camera.elevation, glm::vec3(1.0f, 0.0f, 0.0f))
 	;
-	scene_camera->transform->position = camera.target + camera.radius * (scene_camera->transform->rotation * glm::vec3(0.0f, 0.0f, 1.0f));
-	scene_camera->transform->scale = glm::vec3(1.0f);
+	scene.transforms.set_rotation(scene_camera->transform, rotation);
+	scene.transforms.set_position(scene_camera->transform, camera.target + camera.radius * (rotation * glm::vec3(0.0f, 0.0f, 1.0f)));
+	scene.transforms.set_scale(scene_camera->transform, glm::vec3(1.0f));
 	scene_camera->aspect = float(drawable_size.x) / float(drawable_size.y);
 
 
 	//--- actual drawing ---
 	glClearColor(0.5f, 0.5f, 0.5f, 0.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glDisable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
+	gl_state.disable(GL_BLEND);
+	gl_state.enable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LEQUAL);
 
 	scene.draw(*scene_camera);
 
 	{ //decorate with some lines:
-		DrawLines draw_lines(scene_camera->make_projection() * glm::mat4(scene_camera->transform->make_world_to_local()));
+		DrawLines draw_lines(scene_camera->make_projection() * glm::mat4(scene.transforms.get_world_to_local(scene_camera->transform)));
 
 		//axis (unit-length):
 		draw_lines.draw(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f), glm::u8vec4(0xff, 0x00, 0x00, 0xff));
@@ -152,51 +175,39 @@ void ShowMeshesMode::draw(glm::uvec2 const &drawable_size) {
 }
 
 void ShowMeshesMode::select_prev_mesh() {
-	auto f = buffer.meshes.find(current_mesh_name);
-	if (f != buffer.meshes.end()) --f;
-	if (f == buffer.meshes.end()) f = buffer.meshes.begin();
-
-	if (f != buffer.meshes.end()) {
-		current_mesh_name = f->first;
-		scene_drawable->pipeline.type = f->second.type;
-		scene_drawable->pipeline.start = f->second.start;
-		scene_drawable->pipeline.count = f->second.count;
-		current_mesh_min = f->second.min;
-		current_mesh_max = f->second.max;
-	} else {
-		current_mesh_name = "";
-		scene_drawable->pipeline.type = GL_TRIANGLES;
-		scene_drawable->pipeline.start = 0;
-		scene_drawable->pipeline.count = 0;
-		current_mesh_min = glm::vec3(0.0f);
-		current_mesh_max = glm::vec3(0.0f);
-	}
+	if (current_mesh == -1U) select_mesh(0);
+	else if (current_mesh > 0) select_mesh(current_mesh - 1);
+	else select_mesh(current_mesh);
 }
 
 void ShowMeshesMode::select_next_mesh() {
-	auto f = buffer.meshes.find(current_mesh_name);
-	if (f != buffer.meshes.end()) ++f;
-	if (f == buffer.meshes.end()) {
-		auto temp = buffer.meshes.rbegin();
-		if (temp != buffer.meshes.rend()) {
-			++temp;
-			f = temp.base();
-			assert(f != buffer.meshes.end());
-		}
-	}
+	if (current_mesh == -1U || current_mesh + 1 >= mesh_order.size()) select_mesh(uint32_t(mesh_order.size()) - 1);
+	else select_mesh(current_mesh + 1);
+}
 
-	if (f != buffer.meshes.end()) {
-		current_mesh_name = f->first;
-		scene_drawable->pipeline.type = f->second.type;
-		scene_drawable->pipeline.start = f->second.start;
-		scene_drawable->pipeline.count = f->second.count;
-		current_mesh_min = f->second.min;
-		current_mesh_max = f->second.max;
+void ShowMeshesMode::select_mesh(uint32_t position) {
+	if (position < mesh_order.size()) {
+		uint32_t id = mesh_order[position];
+		Mesh const &mesh = buffer.get(id);
+		current_mesh = position;
+		current_mesh_name = buffer.get_name(id);
+		scene_drawable->pipeline.type = mesh.type;
+		scene_drawable->pipeline.start = mesh.start;
+		scene_drawable->pipeline.count = mesh.count;
+		scene_drawable->pipeline.index_type = mesh.index_type;
+		scene_drawable->pipeline.index_start = mesh.index_start;
+		scene_drawable->pipeline.index_count = mesh.index_count;
+		scene_drawable->pipeline.dequantize = mesh.dequantize;
+		current_mesh_min = mesh.min;
+		current_mesh_max = mesh.max;
 	} else {
+		current_mesh = -1U;
 		current_mesh_name = "";
 		scene_drawable->pipeline.type = GL_TRIANGLES;
 		scene_drawable->pipeline.start = 0;
 		scene_drawable->pipeline.count = 0;
+		scene_drawable->pipeline.index_count = 0;
+		scene_drawable->pipeline.dequantize = glm::mat4x3(1.0f);
 		current_mesh_min = glm::vec3(0.0f);
 		current_mesh_max = glm::vec3(0.0f);
 	}
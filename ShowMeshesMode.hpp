@@ -16,6 +16,7 @@ struct ShowMeshesMode : Mode {
 	virtual ~ShowMeshesMode();
 
 	virtual bool handle_event(SDL_Event const &, glm::uvec2 const &window_size) override;
+	virtual void update(float elapsed) override;
 	virtual void draw(glm::uvec2 const &drawable_size) override;
 
 	//z-up trackball-style camera controls:
@@ -30,12 +31,20 @@ struct ShowMeshesMode : Mode {
 	//MeshBuffer being viewed:
 	MeshBuffer const &buffer;
 
+	//mesh IDs, sorted by name:
+	// (filled in by list_meshes() once the buffer is ready)
+	std::vector< uint32_t > mesh_order;
+	bool listed = false;
+	void list_meshes();
+
 	//currently selected mesh:
+	uint32_t current_mesh = -1U; //(index in mesh_order)
 	std::string current_mesh_name = "";
 	glm::vec3 current_mesh_min = glm::vec3(0.0f);
 	glm::vec3 current_mesh_max = glm::vec3(0.0f);
 	void select_prev_mesh();
 	void select_next_mesh();
+	void select_mesh(uint32_t position); //(clears the selection if position is out of range)
 	
 	//Vertex array object used to bind mesh buffer for drawing:
 	GLuint vao = 0;
@@ -5,7 +5,7 @@
 
 Scene::Drawable::Pipeline show_meshes_program_pipeline;
 
-Load< ShowMeshesProgram > show_meshes_program(LoadTagEarly, []() -> ShowMeshesProgram * {
+Load< ShowMeshesProgram > show_meshes_program(LoadOptions{"show meshes program", LoadOnGLThread, {}, LoadOnFirstUse}, []() -> ShowMeshesProgram * {
 	auto *ret = new ShowMeshesProgram();
 
 	show_meshes_program_pipeline.program = ret->program;
@@ -1,5 +1,6 @@
 #include "ShowSceneMode.hpp"
 #include "DrawLines.hpp"
+#include "gl_state.hpp"
 
 #include <iostream>
 
@@ -7,9 +8,8 @@ ShowSceneMode::ShowSceneMode(Scene const &scene_) : scene(scene_) {
 
 	//Set up camera-only scene:
 	{ //create a single camera:
-		camera_scene.transforms.emplace_back();
-		camera_scene.cameras.emplace_back(&camera_scene.transforms.back());
-		scene_camera = &camera_scene.cameras.back();
+		//(only camera in the scene, so this reference stays put)
+		scene_camera = &camera_scene.cameras[camera_scene.cameras.emplace(camera_scene.transforms.emplace("camera"))];
 		scene_camera->fovy = 60.0f / 180.0f * 3.1415926f;
 		scene_camera->near = 0.01f;
 		//scene_camera->transform and scene_camera->aspect will be set in draw()
@@ -40,7 +40,7 @@ bool ShowSceneMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_
 			if (SDL_GetModState() & KMOD_SHIFT) {
 				//shift: pan
 
-				glm::mat3 frame = glm::mat3_cast(scene_camera->transform->rotation);
+				glm::mat3 frame = glm::mat3_cast(camera_scene.transforms.get_rotation(scene_camera->transform));
 				camera.target -= frame[0] * (delta.x * camera.radius) + frame[1] * (delta.y * camera.radius);
 			} else {
 				//no shift: tumble
@@ -75,28 +75,33 @@ bool ShowSceneMode::handle_event(SDL_Event const &evt, glm::uvec2 const &window_
 void ShowSceneMode::draw(glm::uvec2 const &drawable_size) {
 	//--- use camera structure to set up scene camera ---
 
-	scene_camera->transform->rotation =
+	glm::quat rotation =
 		glm::angleAxis(camera.azimuth, glm::vec3(0.0f, 0.0f, 1.0f))
 		* glm::angleAxis(0.5f * 3.1415926f + -camera.elevation, glm::vec3(1.0f, 0.0f, 0.0f))
 	;
-	scene_camera->transform->position = camera.target + camera.radius * (scene_camera->transform->rotation * glm::vec3(0.0f, 0.0f, 1.0f));
-	scene_camera->transform->scale = glm::vec3(1.0f);
+	camera_scene.transforms.set_rotation(scene_camera->transform, rotation);
+	camera_scene.transforms.set_position(scene_camera->transform, camera.target + camera.radius * (rotation * glm::vec3(0.0f, 0.0f, 1.0f)));
+	camera_scene.transforms.set_scale(scene_camera->transform, glm::vec3(1.0f));
 	scene_camera->aspect = float(drawable_size.x) / float(drawable_size.y);
 
 
 	//--- actual drawing ---
 	glClearColor(0.5f, 0.5f, 0.5f, 0.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glDisable(GL_BLEND);
-	glEnable(GL_DEPTH_TEST);
+	gl_state.disable(GL_BLEND);
+	gl_state.enable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LEQUAL);
 
-	scene.draw(*scene_camera);
+	//(camera lives in camera_scene, so build the world-to-clip matrix here and draw with that)
+	glm::mat4 world_to_clip = scene_camera->make_projection() * glm::mat4(camera_scene.transforms.get_world_to_local(scene_camera->transform));
+	scene.draw(world_to_clip);
 
 	{ //decorate with some lines:
-		DrawLines draw_lines(scene_camera->make_projection() * glm::mat4(scene_camera->transform->make_world_to_local()));
-		for (auto &transform : scene.transforms) {
-			glm::mat4 local_to_world = transform.make_local_to_world();
+		DrawLines draw_lines(world_to_clip);
+		for (uint32_t i = 0; i < scene.transforms.size(); ++i) {
+			if (!scene.transforms.alive(i)) continue;
+			Scene::TransformHandle transform = scene.transforms.handle(i);
+			glm::mat4 local_to_world = scene.transforms.get_local_to_world(transform);
 			auto xf = [&local_to_world](glm::vec3 const &vec) {
 				return glm::vec3(local_to_world * glm::vec4(vec, 1.0f));
 			};
@@ -104,9 +109,9 @@ void ShowSceneMode::draw(glm::uvec2 const &drawable_size) {
 				return glm::vec3(local_to_world * glm::vec4(vec, 0.0f));
 			};
 
-			if (transform.parent) {
+			if (Scene::TransformHandle parent = scene.transforms.get_parent(transform)) {
 				//connect to parent:
-				glm::vec3 p = glm::vec3(transform.parent->make_local_to_world()[3]);
+				glm::vec3 p = glm::vec3(scene.transforms.get_local_to_world(parent)[3]);
 				draw_lines.draw(p, xf(glm::vec3(0.0f)), glm::u8vec4(0xff, 0xff, 0x00, 0xff));
 			}
 
@@ -121,7 +126,7 @@ void ShowSceneMode::draw(glm::uvec2 const &drawable_size) {
 			draw_lines.draw(xf(glm::vec3(0.0f)), xf(glm::vec3(0.0f, 0.0f, -len)), glm::u8vec4(0x00, 0x00, 0x88, 0xff));
 
 			//transform name:
-			draw_lines.draw_text("'" + transform.name + "'",
+			draw_lines.draw_text("'" + scene.transforms.get_name(transform) + "'",
 				xf(glm::vec3(0.05f, 0.0f, 0.05f)),
 				0.15f * xfd(glm::vec3(1.0f, 0.0f, 0.0f)),
 				0.15f * xfd(glm::vec3(0.0f, 0.0f, 1.0f)),
@@ -129,11 +134,51 @@ void ShowSceneMode::draw(glm::uvec2 const &drawable_size) {
 			);
 		}
 		/*
-		glEnable(GL_LINE_SMOOTH);
-		glEnable(GL_BLEND);
+		gl_state.enable(GL_LINE_SMOOTH);
+		gl_state.enable(GL_BLEND);
 		glBlendEquation(GL_FUNC_ADD);
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		*/
 	}
 
+	{ //overlay what scene.draw() issued (and what it skipped) this frame:
+		Scene::DrawStats const &stats = scene.last_draw_stats;
+		std::string text = std::to_string(stats.drawables_culled) + "/" + std::to_string(stats.drawables_cull_tested) + " culled"
+			+ "  " + std::to_string(stats.draw_calls) + " draws"
+			+ " (" + std::to_string(stats.instanced_draw_calls) + " instanced, " + std::to_string(stats.instances) + " instances)"
+			+ "  uniforms " + std::to_string(stats.uniform_uploads) + " (+" + std::to_string(stats.object_block_binds) + " block binds)"
+			+ "  programs " + std::to_string(stats.program_binds) + " (" + std::to_string(stats.program_binds_skipped) + " skipped)"
+			+ "  vaos " + std::to_string(stats.vao_binds) + " (" + std::to_string(stats.vao_binds_skipped) + " skipped)"
+			+ "  textures " + std::to_string(stats.texture_binds) + " (" + std::to_string(stats.texture_binds_skipped) + " skipped)";
+
+		//..and what gl_state issued (and skipped) over the whole previous frame:
+		auto counter = [](char const *name, GLState::Counter const &c) {
+			return std::string(name) + " " + std::to_string(c.issued) + " (" + std::to_string(c.skipped) + " skipped)";
+		};
+		GLState::Counters const &frame = gl_state.last_frame;
+		std::string gl_text = "gl: " + counter("programs", frame.programs)
+			+ "  " + counter("vaos", frame.vertex_arrays)
+			+ "  " + counter("buffers", frame.buffers)
+			+ "  " + counter("textures", frame.textures)
+			+ "  " + counter("enables", frame.capabilities);
+
+		gl_state.disable(GL_DEPTH_TEST);
+		float aspect = float(drawable_size.x) / float(drawable_size.y);
+		DrawLines lines(glm::mat4(
+			1.0f / aspect, 0.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			0.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 1.0f
+		));
+		constexpr float H = 0.05f;
+		lines.draw_text(text,
+			glm::vec3(-aspect + 0.5f * H, -1.0f + 0.5f * H, 0.0f),
+			glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+			glm::u8vec4(0xff, 0xff, 0xff, 0xff));
+		lines.draw_text(gl_text,
+			glm::vec3(-aspect + 0.5f * H, -1.0f + 2.0f * H, 0.0f),
+			glm::vec3(H, 0.0f, 0.0f), glm::vec3(0.0f, H, 0.0f),
+			glm::u8vec4(0xff, 0xff, 0xff, 0xff));
+	}
+
 }
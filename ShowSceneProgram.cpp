@@ -5,7 +5,7 @@
 
 Scene::Drawable::Pipeline show_scene_program_pipeline;
 
-Load< ShowSceneProgram > show_scene_program(LoadTagEarly, []() -> ShowSceneProgram * {
+Load< ShowSceneProgram > show_scene_program(LoadOptions{"show scene program", LoadOnGLThread, {}, LoadOnFirstUse}, []() -> ShowSceneProgram * {
 	auto *ret = new ShowSceneProgram();
 
 	show_scene_program_pipeline.program = ret->program;
@@ -0,0 +1,83 @@
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+WorkerPool::WorkerPool(uint32_t count) {
+	workers.reserve(count);
+	for (uint32_t w = 0; w < count; ++w) {
+		workers.emplace_back([this](){
+			uint64_t seen = 0;
+			std::unique_lock< std::mutex > lock(mutex);
+			while (true) {
+				wake.wait(lock, [&](){ return quit || generation != seen; });
+				if (quit) return;
+				seen = generation;
+
+				lock.unlock();
+				run_chunks();
+				lock.lock();
+
+				assert(busy > 0);
+				busy -= 1;
+				if (busy == 0) done.notify_one();
+			}
+		});
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::unique_lock< std::mutex > lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto &worker : workers) {
+		worker.join();
+	}
+}
+
+void WorkerPool::run_chunks() {
+	while (true) {
+		uint32_t begin = job_next.fetch_add(job_grain);
+		if (begin >= job_count) break;
+		uint32_t end = begin + std::min(job_grain, job_count - begin);
+		(*job)(begin, end);
+	}
+}
+
+void WorkerPool::parallel_for(uint32_t count, uint32_t grain, std::function< void(uint32_t, uint32_t) > const &fn) {
+	if (count == 0) return;
+	grain = std::max(grain, 1U);
+	if (workers.empty() || count <= grain) {
+		fn(0, count);
+		return;
+	}
+
+	std::unique_lock< std::mutex > submit_lock(submit_mutex);
+
+	{ //post the job:
+		std::unique_lock< std::mutex > lock(mutex);
+		job = &fn;
+		job_count = count;
+		job_grain = grain;
+		job_next = 0;
+		busy = uint32_t(workers.size());
+		generation += 1;
+	}
+	wake.notify_all();
+
+	//help out:
+	run_chunks();
+
+	{ //wait for the workers to finish:
+		std::unique_lock< std::mutex > lock(mutex);
+		done.wait(lock, [&](){ return busy == 0; });
+		job = nullptr;
+	}
+}
+
+WorkerPool &WorkerPool::shared() {
+	static WorkerPool pool(std::max(std::thread::hardware_concurrency(), 1U) - 1);
+	return pool;
+}
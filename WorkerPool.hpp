@@ -0,0 +1,60 @@
+#pragma once
+
+/*
+ * A WorkerPool keeps a few threads around for splitting loops across cores:
+ *
+ *   pool.parallel_for(count, grain, [&](uint32_t begin, uint32_t end){
+ *       for (uint32_t i = begin; i < end; ++i) { ... }
+ *   });
+ *
+ * parallel_for hands out [begin,end) chunks of at most 'grain' items to the workers
+ *  *and* the calling thread, and returns once every chunk is done.
+ * Small loops (count <= grain) and pools without workers just run on the calling thread.
+ *
+ * NOTE: jobs from different threads are run one at a time; don't call parallel_for from inside a job.
+ */
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct WorkerPool {
+	//'workers' threads are started in addition to whichever thread calls parallel_for:
+	explicit WorkerPool(uint32_t workers);
+	~WorkerPool();
+
+	WorkerPool(WorkerPool const &) = delete;
+	WorkerPool &operator=(WorkerPool const &) = delete;
+
+	//number of threads that run chunks of a job (workers + the caller):
+	uint32_t threads() const { return uint32_t(workers.size()) + 1; }
+
+	void parallel_for(uint32_t count, uint32_t grain, std::function< void(uint32_t begin, uint32_t end) > const &fn);
+
+	//process-wide pool with one worker per additional hardware thread (created on first use):
+	static WorkerPool &shared();
+
+	//--- internals ---
+	std::vector< std::thread > workers;
+
+	std::mutex submit_mutex; //held for the duration of a job
+
+	std::mutex mutex; //guards everything below
+	std::condition_variable wake; //signalled when a job is posted (or on shutdown)
+	std::condition_variable done; //signalled when the last worker finishes a job
+	bool quit = false;
+	uint64_t generation = 0; //bumped for every job
+	uint32_t busy = 0; //workers that haven't finished the current job
+
+	//current job:
+	std::function< void(uint32_t, uint32_t) > const *job = nullptr;
+	uint32_t job_count = 0;
+	uint32_t job_grain = 0;
+	std::atomic< uint32_t > job_next{0};
+
+	void run_chunks();
+};
@@ -0,0 +1,529 @@
+//bench-scene runs CPU-side timing benchmarks on Scene (no OpenGL context needed):
+// usage: bench-scene [benchmark-name ...]
+// (with no arguments, runs every benchmark)
+
+#include "Scene.hpp"
+#include "WorkerPool.hpp"
+#include "MappedFile.hpp"
+#include "read_write_chunk.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+//-------------------------
+
+//times a function call, in milliseconds:
+static double time_ms(std::function< void() > const &fn) {
+	auto before = std::chrono::high_resolution_clock::now();
+	fn();
+	auto after = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration< double, std::milli >(after - before).count();
+}
+
+//spawn and despawn apple -> stem -> leaf hierarchies (as in PlayMode::spawn_apple / remove_apples)
+// at a steady 10k apples per simulated second, with each apple living for two seconds:
+static void bench_apples() {
+	constexpr uint32_t SpawnsPerSecond = 10000;
+	constexpr uint32_t FramesPerSecond = 60;
+	constexpr uint32_t Seconds = 10;
+	constexpr uint32_t LifetimeFrames = 2 * FramesPerSecond;
+
+	Scene scene;
+
+	struct Apple {
+		uint32_t spawn_frame;
+		Scene::DrawableHandle drawable, stem_drawable, leaf_drawable;
+	};
+	std::deque< Apple > apples;
+
+	uint32_t spawned = 0;
+	uint32_t despawned = 0;
+	double total_ms = 0.0;
+	double worst_ms = 0.0;
+
+	for (uint32_t frame = 0; frame < Seconds * FramesPerSecond; ++frame) {
+		double ms = time_ms([&](){
+			//despawn expired apples:
+			while (!apples.empty() && apples.front().spawn_frame + LifetimeFrames <= frame) {
+				Apple const &apple = apples.front();
+				Scene::TransformHandle apple_t = scene.drawables[apple.drawable].transform;
+				Scene::TransformHandle stem_t = scene.drawables[apple.stem_drawable].transform;
+				Scene::TransformHandle leaf_t = scene.drawables[apple.leaf_drawable].transform;
+				scene.drawables.erase(apple.drawable);
+				scene.drawables.erase(apple.stem_drawable);
+				scene.drawables.erase(apple.leaf_drawable);
+				scene.transforms.erase(leaf_t);
+				scene.transforms.erase(stem_t);
+				scene.transforms.erase(apple_t);
+				apples.pop_front();
+				++despawned;
+			}
+
+			//spawn this frame's share of new apples:
+			uint32_t target = (frame + 1) * SpawnsPerSecond / FramesPerSecond;
+			while (spawned < target) {
+				Apple apple;
+				apple.spawn_frame = frame;
+				float x = float(spawned % 97) - 48.0f;
+				float y = float(spawned % 89) - 44.0f;
+
+				Scene::TransformHandle apple_t = scene.transforms.emplace("apple");
+				scene.transforms.set_position(apple_t, glm::vec3(x, y, -2.0f));
+				Scene::TransformHandle stem_t = scene.transforms.emplace("stem", apple_t);
+				scene.transforms.set_position(stem_t, glm::vec3(0.0f, 0.0f, 0.5f));
+				Scene::TransformHandle leaf_t = scene.transforms.emplace("leaf", stem_t);
+				scene.transforms.set_position(leaf_t, glm::vec3(0.1f, 0.0f, 0.2f));
+
+				apple.drawable = scene.drawables.emplace(apple_t);
+				apple.stem_drawable = scene.drawables.emplace(stem_t);
+				apple.leaf_drawable = scene.drawables.emplace(leaf_t);
+				apples.emplace_back(apple);
+				++spawned;
+			}
+
+			//bob every live apple (as PlayMode::update does) and flatten the hierarchy:
+			for (Apple const &apple : apples) {
+				Scene::TransformHandle apple_t = scene.drawables[apple.drawable].transform;
+				glm::vec3 position = scene.transforms.get_position(apple_t);
+				position.z = -2.0f + 0.01f * float(frame - apple.spawn_frame);
+				scene.transforms.set_position(apple_t, position);
+			}
+			scene.transforms.update();
+		});
+		total_ms += ms;
+		worst_ms = std::max(worst_ms, ms);
+	}
+
+	std::cout << "apples: " << spawned << " spawned, " << despawned << " despawned over " << Seconds * FramesPerSecond << " frames"
+		<< " (" << scene.drawables.size() << " drawables live at end)" << std::endl;
+	std::cout << "  " << total_ms / (Seconds * FramesPerSecond) << " ms/frame average, " << worst_ms << " ms worst frame" << std::endl;
+	std::cout << "  " << (spawned + despawned) / (total_ms / 1000.0) << " spawns+despawns per second of CPU time" << std::endl;
+
+	//sanity check: handles from before a clear() stay stale once their slots are reused:
+	{
+		Scene fresh;
+		Scene::TransformHandle t = fresh.transforms.emplace("check");
+		Scene::DrawableHandle old_drawable = fresh.drawables.emplace(t);
+		fresh.drawables.clear();
+		fresh.drawables.emplace(t);
+		if (fresh.drawables.slots.find(old_drawable) != -1U) {
+			throw std::runtime_error("drawable handle from before clear() refers to a new drawable");
+		}
+		fresh.drawables.clear();
+		fresh.transforms.clear();
+		fresh.transforms.emplace("check again");
+		if (fresh.transforms.slots.find(t) != -1U) {
+			throw std::runtime_error("transform handle from before clear() refers to a new transform");
+		}
+	}
+}
+
+//clone a 100k-transform scene (as PlayMode's constructor does with snake_scene):
+// once into a fresh scene and repeatedly into a scene whose storage can be reused.
+static void bench_clone() {
+	constexpr uint32_t TransformCount = 100000;
+	constexpr uint32_t Clones = 20;
+
+	Scene scene;
+	{ //build a forest of small hierarchies, with a drawable on every other transform:
+		std::vector< Scene::TransformHandle > recent;
+		for (uint32_t i = 0; i < TransformCount; ++i) {
+			Scene::TransformHandle parent;
+			if (i % 10 != 0) parent = recent[(i * 7) % recent.size()];
+			if (i % 10 == 0) recent.clear();
+			Scene::TransformHandle t = scene.transforms.emplace("t" + std::to_string(i), parent);
+			scene.transforms.set_position(t, glm::vec3(float(i % 13), float(i % 17), float(i % 19)));
+			recent.emplace_back(t);
+			if (i % 2 == 0) scene.drawables.emplace(t);
+		}
+		scene.cameras.emplace(scene.transforms.handle(0));
+		scene.lights.emplace(scene.transforms.handle(1));
+	}
+
+	double first_ms = time_ms([&](){
+		Scene copy(scene);
+	});
+
+	Scene target;
+	double total_ms = 0.0;
+	double worst_ms = 0.0;
+	for (uint32_t c = 0; c < Clones; ++c) {
+		double ms = time_ms([&](){
+			target.set(scene);
+		});
+		total_ms += ms;
+		worst_ms = std::max(worst_ms, ms);
+	}
+
+	//sanity check: handles into the original refer to the same objects in the copy:
+	for (auto const &drawable : scene.drawables) {
+		if (target.transforms.get_name(drawable.transform) != scene.transforms.get_name(drawable.transform)) {
+			throw std::runtime_error("clone did not preserve transform handles");
+		}
+	}
+
+	std::cout << "clone: " << scene.transforms.count() << " transforms, " << scene.drawables.size() << " drawables" << std::endl;
+	std::cout << "  " << first_ms << " ms into a new scene" << std::endl;
+	std::cout << "  " << total_ms / Clones << " ms average, " << worst_ms << " ms worst into an existing scene (" << Clones << " clones)" << std::endl;
+	std::cout << "  " << scene.transforms.count() / (total_ms / Clones / 1000.0) << " transforms cloned per second" << std::endl;
+}
+
+//update world matrices of a 300k-transform scene (a forest of shallow trees, all moving every frame),
+// spreading the hierarchy pass over 1 .. hardware_concurrency threads:
+static void bench_update_threads() {
+	constexpr uint32_t TransformCount = 300000;
+	constexpr uint32_t Frames = 30;
+
+	Scene::TransformStore store;
+	std::vector< Scene::TransformHandle > roots;
+	{ //each transform's parent is the transform (i-1)/4 places back in its tree, giving trees ~8 levels deep:
+		std::vector< Scene::TransformHandle > tree;
+		for (uint32_t i = 0; i < TransformCount; ++i) {
+			if (i % 20000 == 0) tree.clear();
+			Scene::TransformHandle parent = (tree.empty() ? Scene::TransformHandle() : tree[(tree.size() - 1) / 4]);
+			Scene::TransformHandle t = store.emplace("", parent);
+			store.set_position(t, glm::vec3(0.01f * float(i % 7), 0.02f * float(i % 5), 0.01f));
+			store.set_rotation(t, glm::angleAxis(0.001f * float(i % 11), glm::vec3(0.0f, 0.0f, 1.0f)));
+			if (tree.empty()) roots.emplace_back(t);
+			tree.emplace_back(t);
+		}
+	}
+
+	auto run = [&](WorkerPool &workers) {
+		double total_ms = 0.0;
+		for (uint32_t frame = 0; frame < Frames; ++frame) {
+			for (Scene::TransformHandle root : roots) {
+				store.set_position(root, glm::vec3(float(frame), 0.0f, 0.0f));
+			}
+			total_ms += time_ms([&](){
+				store.update(workers);
+			});
+		}
+		return total_ms / Frames;
+	};
+
+	WorkerPool serial(0);
+	double serial_ms = run(serial);
+	std::vector< glm::mat4x3 > reference = store.local_to_worlds;
+
+	std::cout << "update_threads: " << store.count() << " transforms, " << roots.size() << " roots, " << store.level_starts.size() - 1 << " levels" << std::endl;
+	//1, 2, 4, ... threads, and finally every hardware thread:
+	uint32_t max_threads = std::max(std::thread::hardware_concurrency(), 1U);
+	std::vector< uint32_t > thread_counts;
+	for (uint32_t threads = 1; threads < max_threads; threads *= 2) thread_counts.emplace_back(threads);
+	thread_counts.emplace_back(max_threads);
+
+	for (uint32_t threads : thread_counts) {
+		WorkerPool workers(threads - 1);
+		double ms = run(workers);
+		bool same = (std::memcmp(reference.data(), store.local_to_worlds.data(), reference.size() * sizeof(glm::mat4x3)) == 0);
+		std::cout << "  " << threads << " thread(s): " << ms << " ms/update (" << serial_ms / ms << "x vs. serial)" << (same ? "" : " RESULTS DIFFER") << std::endl;
+		if (!same) throw std::runtime_error("parallel update did not match serial update");
+	}
+}
+
+//process-owned (anonymous) resident memory, in kilobytes -- file-backed pages of a mapping aren't counted:
+static size_t anonymous_rss_kb() {
+#ifdef __linux__
+	std::ifstream status("/proc/self/status");
+	std::string line;
+	while (std::getline(status, line)) {
+		if (line.compare(0, 8, "RssAnon:") == 0) return size_t(std::stoull(line.substr(8)));
+	}
+#endif
+	return 0;
+}
+
+//load a large synthetic .scene and .pnct file by copying chunks out of a stream (read_chunk)
+// vs. using them in place in a MappedFile (ChunkReader):
+static void bench_load() {
+	constexpr uint32_t TransformCount = 200000;
+	constexpr uint32_t VertexCount = 2000000;
+
+	//same layouts as Scene::load / MeshBuffer::MeshBuffer:
+	struct HierarchyEntry {
+		uint32_t parent;
+		uint32_t name_begin, name_end;
+		glm::vec3 position;
+		glm::quat rotation;
+		glm::vec3 scale;
+	};
+	struct MeshEntry { uint32_t transform, name_begin, name_end; };
+	struct CameraEntry { uint32_t transform; char type[4]; float data, clip_near, clip_far; };
+	struct LightEntry { uint32_t transform; char type; glm::u8vec3 color; float energy, distance, fov; };
+	struct Vertex { glm::vec3 Position, Normal; glm::u8vec4 Color; glm::vec2 TexCoord; };
+
+	std::filesystem::path dir = std::filesystem::temp_directory_path();
+	std::string scene_file = (dir / "bench-load.scene").string();
+	std::string toc_scene_file = (dir / "bench-load-toc.scene").string(); //same chunks, written with a table of contents
+	std::string pnct_file = (dir / "bench-load.pnct").string();
+
+	{ //write files:
+		std::vector< char > names;
+		std::vector< HierarchyEntry > hierarchy;
+		std::vector< MeshEntry > meshes;
+		for (uint32_t i = 0; i < TransformCount; ++i) {
+			std::string name = "Object." + std::to_string(i);
+			HierarchyEntry h;
+			h.parent = (i % 8 == 0 ? -1U : i - 1);
+			h.name_begin = uint32_t(names.size());
+			names.insert(names.end(), name.begin(), name.end());
+			h.name_end = uint32_t(names.size());
+			h.position = glm::vec3(float(i), 0.0f, 0.0f);
+			h.rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+			h.scale = glm::vec3(1.0f);
+			hierarchy.emplace_back(h);
+			meshes.emplace_back(MeshEntry{i, h.name_begin, h.name_end});
+		}
+		std::vector< CameraEntry > cameras{ CameraEntry{0, {'p','e','r','s'}, 60.0f, 0.1f, 100.0f} };
+		std::vector< LightEntry > lights{ LightEntry{0, 'p', glm::u8vec3(0xff), 1.0f, 10.0f, 45.0f} };
+
+		std::ofstream scene(scene_file, std::ios::binary);
+		write_chunk("str0", names, &scene);
+		write_chunk("xfh0", hierarchy, &scene);
+		write_chunk("msh0", meshes, &scene);
+		write_chunk("cam0", cameras, &scene);
+		write_chunk("lmp0", lights, &scene);
+
+		ChunkWriter toc_writer;
+		write_chunk("str0", names, &toc_writer);
+		write_chunk("xfh0", hierarchy, &toc_writer);
+		write_chunk("msh0", meshes, &toc_writer);
+		write_chunk("cam0", cameras, &toc_writer);
+		write_chunk("lmp0", lights, &toc_writer);
+		std::ofstream toc_scene(toc_scene_file, std::ios::binary);
+		toc_writer.write(&toc_scene);
+
+		std::vector< Vertex > vertices(VertexCount);
+		for (uint32_t i = 0; i < VertexCount; ++i) {
+			vertices[i].Position = glm::vec3(float(i % 1000), float(i / 1000), 0.0f);
+		}
+		std::ofstream pnct(pnct_file, std::ios::binary);
+		write_chunk("pnct", vertices, &pnct);
+	}
+
+	//each variant reads every chunk and touches every element (as the loaders do), reporting time and memory still held:
+	auto report = [](char const *what, double ms, size_t rss_before) {
+		size_t rss_after = anonymous_rss_kb();
+		std::cout << "  " << what << ": " << ms << " ms, +" << (rss_after > rss_before ? rss_after - rss_before : 0) << " kB anonymous RSS" << std::endl;
+	};
+
+	float checksum = 0.0f;
+	auto touch_scene = [&](auto const &hierarchy, auto const &meshes) {
+		for (auto const &h : hierarchy) checksum += h.position.x;
+		for (auto const &m : meshes) checksum += float(m.transform);
+	};
+	auto touch_vertices = [&](auto const &vertices) {
+		for (auto const &v : vertices) checksum += v.Position.y;
+	};
+
+	std::cout << "load: " << TransformCount << " transforms (" << std::filesystem::file_size(scene_file) / 1024 << " kB), "
+		<< VertexCount << " vertices (" << std::filesystem::file_size(pnct_file) / 1024 << " kB)" << std::endl;
+
+	{ //before: copy chunks out of a stream:
+		size_t rss_before = anonymous_rss_kb();
+		std::vector< char > names;
+		std::vector< HierarchyEntry > hierarchy;
+		std::vector< MeshEntry > meshes;
+		std::vector< CameraEntry > cameras;
+		std::vector< LightEntry > lights;
+		std::vector< Vertex > vertices;
+		double ms = time_ms([&](){
+			std::ifstream scene(scene_file, std::ios::binary);
+			read_chunk(scene, "str0", &names);
+			read_chunk(scene, "xfh0", &hierarchy);
+			read_chunk(scene, "msh0", &meshes);
+			read_chunk(scene, "cam0", &cameras);
+			read_chunk(scene, "lmp0", &lights);
+			touch_scene(hierarchy, meshes);
+			std::ifstream pnct(pnct_file, std::ios::binary);
+			read_chunk(pnct, "pnct", &vertices);
+			touch_vertices(vertices);
+		});
+		report("read_chunk", ms, rss_before);
+	}
+
+	{ //after: views into a mapping:
+		size_t rss_before = anonymous_rss_kb();
+		std::unique_ptr< MappedFile > scene, pnct;
+		ChunkView< char > names;
+		ChunkView< HierarchyEntry > hierarchy;
+		ChunkView< MeshEntry > meshes;
+		ChunkView< Vertex > vertices;
+		double ms = time_ms([&](){
+			scene.reset(new MappedFile(scene_file));
+			ChunkReader scene_reader(scene->data(), scene->data() + scene->size());
+			names = scene_reader.read< char >("str0");
+			hierarchy = scene_reader.read< HierarchyEntry >("xfh0");
+			meshes = scene_reader.read< MeshEntry >("msh0");
+			scene_reader.read< CameraEntry >("cam0");
+			scene_reader.read< LightEntry >("lmp0");
+			touch_scene(hierarchy, meshes);
+			pnct.reset(new MappedFile(pnct_file));
+			ChunkReader pnct_reader(pnct->data(), pnct->data() + pnct->size());
+			vertices = pnct_reader.read< Vertex >("pnct");
+			touch_vertices(vertices);
+		});
+		report("ChunkReader", ms, rss_before);
+	}
+
+	//stream vertices through a fixed-size block, from a stream and from a mapping:
+	for (bool mapped : {false, true}) {
+		size_t rss_before = anonymous_rss_kb();
+		constexpr size_t BlockVertices = 65536;
+		std::vector< Vertex > buffer(BlockVertices);
+		double mb_per_s = 0.0;
+		double ms = time_ms([&](){
+			std::ifstream pnct_stream;
+			std::unique_ptr< MappedFile > pnct;
+			std::unique_ptr< ChunkReader > pnct_reader;
+			std::unique_ptr< ChunkStream< Vertex > > stream;
+			if (mapped) {
+				pnct.reset(new MappedFile(pnct_file));
+				pnct_reader.reset(new ChunkReader(pnct->data(), pnct->data() + pnct->size()));
+				stream.reset(new ChunkStream< Vertex >(*pnct_reader, "pnct"));
+			} else {
+				pnct_stream.open(pnct_file, std::ios::binary);
+				stream.reset(new ChunkStream< Vertex >(pnct_stream, "pnct"));
+			}
+			Vertex const *block = nullptr;
+			while (size_t count = stream->next(buffer.data(), buffer.size(), &block)) {
+				for (size_t i = 0; i < count; ++i) checksum += block[i].Position.y;
+			}
+			mb_per_s = stream->mb_per_s();
+		});
+		std::string what = std::string("ChunkStream (") + (mapped ? "mapped" : "istream") + ", " + std::to_string(int(mb_per_s)) + " MB/s)";
+		report(what.c_str(), ms, rss_before);
+	}
+
+	//whole Scene::load (which uses ChunkReader), from the plain and table-of-contents files:
+	for (std::string const &file : {scene_file, toc_scene_file}) {
+		size_t rss_before = anonymous_rss_kb();
+		Scene scene;
+		double ms = time_ms([&](){
+			scene.load(file);
+		});
+		report(file == scene_file ? "Scene::load" : "Scene::load (toc1)", ms, rss_before);
+	}
+
+	if (checksum == 0.0f) std::cout << "  (checksum was zero)" << std::endl;
+
+	std::filesystem::remove(scene_file);
+	std::filesystem::remove(toc_scene_file);
+	std::filesystem::remove(pnct_file);
+}
+
+//load a large synthetic .pnct-style chunk stored raw vs. compressed (ChunkBlocks),
+// decompressing on one thread vs. every hardware thread:
+static void bench_compressed() {
+	constexpr uint32_t VertexCount = 2000000;
+	constexpr int Level = 6;
+
+	struct Vertex { glm::vec3 Position, Normal; glm::u8vec4 Color; glm::vec2 TexCoord; };
+
+	std::filesystem::path dir = std::filesystem::temp_directory_path();
+	std::string raw_file = (dir / "bench-compressed-raw.pnct").string();
+	std::string compressed_file = (dir / "bench-compressed.pnct").string();
+
+	{ //a grid of quads with a few colors, so the data compresses about as well as exported meshes:
+		std::vector< Vertex > vertices(VertexCount);
+		for (uint32_t i = 0; i < VertexCount; ++i) {
+			uint32_t quad = i / 6;
+			vertices[i].Position = glm::vec3(float(quad % 1024) + float(i % 2), float(quad / 1024) + float((i / 2) % 2), 0.1f * float(quad % 7));
+			vertices[i].Normal = glm::vec3(0.0f, 0.0f, 1.0f);
+			vertices[i].Color = glm::u8vec4(0x40 * (quad % 4), 0x80, 0xff, 0xff);
+			vertices[i].TexCoord = glm::vec2(float(i % 2), float((i / 2) % 2));
+		}
+
+		ChunkWriter raw;
+		write_chunk("pnct", vertices, &raw);
+		std::ofstream raw_out(raw_file, std::ios::binary);
+		raw.write(&raw_out);
+
+		ChunkWriter compressed;
+		double ms = time_ms([&](){
+			write_chunk("pnct", vertices, &compressed, Level);
+		});
+		std::ofstream compressed_out(compressed_file, std::ios::binary);
+		compressed.write(&compressed_out);
+		std::cout << "compressed: " << VertexCount << " vertices; raw " << std::filesystem::file_size(raw_file) / 1024 << " kB, "
+			<< "level " << Level << " " << std::filesystem::file_size(compressed_file) / 1024 << " kB (compressed in " << ms << " ms on " << WorkerPool::shared().threads() << " thread(s))" << std::endl;
+	}
+
+	float checksum = 0.0f;
+	auto run = [&](char const *what, std::string const &filename, WorkerPool &workers) {
+		constexpr uint32_t Runs = 5;
+		double total_ms = 0.0;
+		for (uint32_t run = 0; run < Runs; ++run) {
+			total_ms += time_ms([&](){
+				MappedFile file(filename);
+				ChunkReader reader(file.data(), file.data() + file.size());
+				reader.workers = &workers;
+				ChunkView< Vertex > vertices = reader.find< Vertex >("pnct");
+				for (auto const &v : vertices) checksum += v.Position.y;
+			});
+		}
+		double ms = total_ms / Runs;
+		std::cout << "  " << what << ": " << ms << " ms (" << double(VertexCount * sizeof(Vertex)) / (1024.0 * 1024.0) / (ms / 1000.0) << " MB/s of vertices)" << std::endl;
+	};
+
+	WorkerPool serial(0);
+	run("raw", raw_file, serial);
+	run("compressed, 1 thread", compressed_file, serial);
+	std::string all = "compressed, " + std::to_string(WorkerPool::shared().threads()) + " thread(s)";
+	run(all.c_str(), compressed_file, WorkerPool::shared());
+
+	if (checksum == 0.0f) std::cout << "  (checksum was zero)" << std::endl;
+
+	std::filesystem::remove(raw_file);
+	std::filesystem::remove(compressed_file);
+}
+
+//-------------------------
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	//when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+	try {
+#endif
+
+	std::vector< std::pair< std::string, std::function< void() > > > benchmarks = {
+		{"apples", bench_apples},
+		{"clone", bench_clone},
+		{"update_threads", bench_update_threads},
+		{"load", bench_load},
+		{"compressed", bench_compressed},
+	};
+
+	std::vector< std::string > selected(argv + 1, argv + argc);
+	for (auto const &benchmark : benchmarks) {
+		if (!selected.empty() && std::find(selected.begin(), selected.end(), benchmark.first) == selected.end()) continue;
+		std::cout << "--- " << benchmark.first << " ---" << std::endl;
+		benchmark.second();
+	}
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
@@ -1,5 +1,7 @@
 #include "data_path.hpp"
 
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
 #include <vector>
 #include <sstream>
@@ -62,6 +64,37 @@ std::string data_path(std::string const &suffix) {
 	return path + "/" + suffix;
 }
 
+//This function finds (and creates) the per-user cache directory, or returns "" if there isn't one:
+static std::string get_cache_dir() {
+	std::string base;
+	#if defined(_WIN32)
+	char local[MAX_PATH];
+	DWORD got = GetEnvironmentVariableA("LOCALAPPDATA", local, MAX_PATH); //(not getenv, which MSVC warns about)
+	if (got > 0 && got < MAX_PATH) base = std::string(local, got);
+	#elif defined(__APPLE__)
+	if (char const *home = std::getenv("HOME")) base = std::string(home) + "/Library/Caches";
+	#else
+	if (char const *xdg = std::getenv("XDG_CACHE_HOME"); xdg && xdg[0] == '/') base = xdg;
+	else if (char const *home = std::getenv("HOME")) base = std::string(home) + "/.cache";
+	#endif
+	if (base.empty()) return "";
+
+	std::string ret = base + "/SnakeBop";
+	std::error_code ec;
+	std::filesystem::create_directories(ret, ec);
+	if (!std::filesystem::is_directory(ret, ec)) {
+		std::cerr << "NOTE: couldn't make cache directory '" << ret << "'; not caching." << std::endl;
+		return "";
+	}
+	return ret;
+}
+
+std::string cache_path(std::string const &suffix) {
+	static std::string path = get_cache_dir(); //cache result of get_cache_dir()
+	if (path.empty()) return "";
+	return path + "/" + suffix;
+}
+
 /* From Rktcr; to be used eventually!
 static std::string make_user_dir(std::string const &app_name) {
 	std::string ret = "";
@@ -5,3 +5,9 @@
 //construct a path based on the location of the currently-running executable:
 // (e.g. if running /home/ix/game0/game.exe will return '/home/ix/game0/' + suffix)
 std::string data_path(std::string const &suffix);
+
+//construct a path in the per-user cache directory, creating the directory if needed:
+// (e.g. $XDG_CACHE_HOME/SnakeBop/ + suffix or ~/.cache/SnakeBop/ + suffix on Linux,
+//  ~/Library/Caches/SnakeBop/ on macOS, %LOCALAPPDATA%/SnakeBop/ on Windows)
+// returns "" if there is no usable cache directory; things kept there should be safe to lose.
+std::string cache_path(std::string const &suffix);
@@ -1,10 +1,128 @@
 #include "gl_compile_program.hpp"
+#include "data_path.hpp"
+#include "MappedFile.hpp"
+#include "read_write_chunk.hpp"
 
+#include <SDL.h>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
 #include <vector>
 #include <string>
 #include <stdexcept>
 #include <iostream>
 
+//program binaries are GL 4.1 (or ARB_get_program_binary), so they aren't in the 3.3 core GL.hpp;
+// the entry points are looked up at runtime instead:
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+//Linked programs are cached in cache_path("program-<hash of sources>.bin") as chunks:
+// "pgh0" -- one CachedProgram header
+// "pgb0" -- the program binary, as returned by glGetProgramBinary
+//A file is only used if its hashes match the sources and the driver (vendor, renderer, version) it was made with;
+// otherwise (or if the driver rejects the binary) the program is compiled from source and the file is rewritten.
+struct CachedProgram {
+	uint64_t source_hash = 0;
+	uint64_t driver_hash = 0;
+	uint32_t format = 0; //binary format, from glGetProgramBinary
+	float compile_ms = 0.0f; //how long compiling from source took (so hits can report time saved)
+};
+static_assert(sizeof(CachedProgram) == 8 + 8 + 4 + 4, "CachedProgram is packed.");
+
+struct ProgramCache {
+	bool enabled = false;
+	std::string disabled_reason;
+	uint64_t driver_hash = 0;
+
+	void (APIENTRY *ProgramBinary)(GLuint program, GLenum format, void const *binary, GLsizei length) = nullptr;
+	void (APIENTRY *GetProgramBinary)(GLuint program, GLsizei size, GLsizei *length, GLenum *format, void *binary) = nullptr;
+	void (APIENTRY *ProgramParameteri)(GLuint program, GLenum pname, GLint value) = nullptr;
+
+	//stats (see report_program_cache):
+	uint32_t hits = 0;
+	uint32_t misses = 0;
+	uint32_t rejected = 0; //(also counted in misses)
+	double hit_ms = 0.0; //time spent loading binaries
+	double miss_ms = 0.0; //time spent compiling from source
+	double saved_ms = 0.0; //cached compile time minus load time, over all hits
+};
+
+static uint64_t hash_bytes(uint64_t hash, std::string const &bytes) {
+	//64-bit FNV-1a, including the terminating '\0' (so consecutive strings can't run together):
+	char const *c = bytes.c_str();
+	for (size_t i = 0; i <= bytes.size(); ++i) {
+		hash ^= uint8_t(c[i]);
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+static bool program_cache_ready = false; //has get_program_cache() been called?
+
+//(needs a current GL context, so is set up on first use from the GL thread)
+static ProgramCache &get_program_cache() {
+	static ProgramCache cache = [](){
+		program_cache_ready = true;
+		ProgramCache ret;
+		auto gl_string = [](GLenum name) {
+			GLubyte const *str = glGetString(name);
+			return std::string(str ? reinterpret_cast< char const * >(str) : "");
+		};
+		std::string version = gl_string(GL_VERSION);
+
+		int major = 0, minor = 0;
+		char dot = '\0';
+		std::istringstream(version) >> major >> dot >> minor; //(versions start "major.minor")
+		bool supported = (major > 4 || (major == 4 && minor >= 1));
+		if (!supported) {
+			GLint extensions = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+			for (GLint i = 0; i < extensions; ++i) {
+				GLubyte const *ext = glGetStringi(GL_EXTENSIONS, GLuint(i));
+				if (ext && std::string(reinterpret_cast< char const * >(ext)) == "GL_ARB_get_program_binary") supported = true;
+			}
+		}
+		if (!supported) {
+			ret.disabled_reason = "GL " + version + " doesn't support program binaries";
+			return ret;
+		}
+
+		ret.ProgramBinary = (decltype(ret.ProgramBinary))SDL_GL_GetProcAddress("glProgramBinary");
+		ret.GetProgramBinary = (decltype(ret.GetProgramBinary))SDL_GL_GetProcAddress("glGetProgramBinary");
+		ret.ProgramParameteri = (decltype(ret.ProgramParameteri))SDL_GL_GetProcAddress("glProgramParameteri");
+		if (!ret.ProgramBinary || !ret.GetProgramBinary || !ret.ProgramParameteri) {
+			ret.disabled_reason = "program binary functions are missing";
+			return ret;
+		}
+
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		if (formats <= 0) {
+			ret.disabled_reason = "the driver has no program binary formats";
+			return ret;
+		}
+
+		if (cache_path("").empty()) {
+			ret.disabled_reason = "there is no cache directory";
+			return ret;
+		}
+
+		ret.driver_hash = 0xcbf29ce484222325ULL;
+		ret.driver_hash = hash_bytes(ret.driver_hash, gl_string(GL_VENDOR));
+		ret.driver_hash = hash_bytes(ret.driver_hash, gl_string(GL_RENDERER));
+		ret.driver_hash = hash_bytes(ret.driver_hash, version);
+		ret.enabled = true;
+		return ret;
+	}();
+	return cache;
+}
+
 static GLuint gl_compile_shader(GLenum type, std::string const &source) {
 	GLuint shader = glCreateShader(type);
 	GLchar const *str = source.c_str();
@@ -27,11 +145,108 @@ static GLuint gl_compile_shader(GLenum type, std::string const &source) {
 	return shader;
 }
 
+//try to make a program from the cached binary in 'filename'; returns 0 (and cleans up) if it can't:
+static GLuint load_cached_program(ProgramCache &cache, std::string const &filename, uint64_t source_hash, float *compile_ms) {
+	if (!std::filesystem::exists(filename)) return 0;
+
+	CachedProgram header;
+	GLuint program = 0;
+	try {
+		MappedFile file(filename);
+		ChunkReader reader(file.data(), file.data() + file.size());
+		ChunkView< CachedProgram > headers = reader.find< CachedProgram >("pgh0");
+		ChunkView< char > binary = reader.find< char >("pgb0");
+		if (headers.size() != 1 || binary.empty()) return 0; //(malformed; will be rewritten once compiled)
+		header = headers[0];
+		if (header.source_hash != source_hash || header.driver_hash != cache.driver_hash) return 0; //(stale; likewise)
+
+		program = glCreateProgram();
+		cache.ProgramBinary(program, GLenum(header.format), binary.data(), GLsizei(binary.size()));
+	} catch (std::runtime_error &) {
+		return 0;
+	}
+	GLint link_status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &link_status);
+	if (link_status != GL_TRUE) {
+		//the driver can refuse binaries it made (e.g., after an update that kept its version string):
+		glDeleteProgram(program);
+		while (glGetError() != GL_NO_ERROR) { } //(a refused format is reported as an error, which isn't ours to report)
+		std::remove(filename.c_str());
+		cache.rejected += 1;
+		return 0;
+	}
+	*compile_ms = header.compile_ms;
+	return program;
+}
+
+//save the binary of a just-linked 'program' to 'filename' (silently giving up on failure -- the cache is only a cache):
+static void save_cached_program(ProgramCache &cache, std::string const &filename, GLuint program, uint64_t source_hash, float compile_ms) {
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0) return;
+
+	std::vector< CachedProgram > header(1);
+	header[0].source_hash = source_hash;
+	header[0].driver_hash = cache.driver_hash;
+	header[0].compile_ms = compile_ms;
+	std::vector< char > binary(size_t(length), '\0');
+	GLsizei written = 0;
+	GLenum format = 0;
+	cache.GetProgramBinary(program, length, &written, &format, binary.data());
+	if (written <= 0) return;
+	binary.resize(size_t(written));
+	header[0].format = uint32_t(format);
+
+	ChunkWriter writer;
+	writer.add("pgh0", header);
+	writer.add("pgb0", binary);
+
+	//write then rename, so another instance never reads a half-written file:
+	std::string temp = filename + ".tmp";
+	{
+		std::ofstream out(temp, std::ios::binary);
+		writer.write(&out);
+		if (!out) {
+			out.close();
+			std::remove(temp.c_str());
+			return;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename(temp, filename, ec);
+	if (ec) std::remove(temp.c_str());
+}
+
 GLuint gl_compile_program(
 	std::string const &vertex_shader_source,
 	std::string const &fragment_shader_source
 	) {
 
+	ProgramCache &cache = get_program_cache();
+	auto before = std::chrono::high_resolution_clock::now();
+	auto ms_since_before = [&before]() {
+		return std::chrono::duration< double, std::milli >(std::chrono::high_resolution_clock::now() - before).count();
+	};
+
+	uint64_t source_hash = 0xcbf29ce484222325ULL;
+	source_hash = hash_bytes(source_hash, vertex_shader_source);
+	source_hash = hash_bytes(source_hash, fragment_shader_source);
+	std::string cache_file;
+	if (cache.enabled) {
+		char hex[17];
+		std::snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)source_hash);
+		cache_file = cache_path(std::string("program-") + hex + ".bin");
+
+		float compile_ms = 0.0f;
+		if (GLuint program = load_cached_program(cache, cache_file, source_hash, &compile_ms)) {
+			double ms = ms_since_before();
+			cache.hits += 1;
+			cache.hit_ms += ms;
+			cache.saved_ms += compile_ms - ms;
+			return program;
+		}
+	}
+
 	GLuint vertex_shader = gl_compile_shader(GL_VERTEX_SHADER, vertex_shader_source);
 	GLuint fragment_shader = gl_compile_shader(GL_FRAGMENT_SHADER, fragment_shader_source);
 
@@ -43,6 +258,9 @@ GLuint gl_compile_program(
 	glDeleteShader(vertex_shader);
 	glDeleteShader(fragment_shader);
 
+	//ask to be able to read back the program binary (for the cache):
+	if (cache.enabled) cache.ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
 	//link the shader program and throw errors if linking fails:
 	glLinkProgram(program);
 	GLint link_status = GL_FALSE;
@@ -58,5 +276,28 @@ GLuint gl_compile_program(
 		throw std::runtime_error("failed to link program");
 	}
 
+	if (cache.enabled) {
+		double ms = ms_since_before();
+		cache.misses += 1;
+		cache.miss_ms += ms;
+		save_cached_program(cache, cache_file, program, source_hash, float(ms));
+	}
+
 	return program;
 }
+
+void report_program_cache() {
+	if (!program_cache_ready) return; //(no programs were compiled)
+	ProgramCache const &cache = get_program_cache();
+	if (!cache.enabled) {
+		std::cout << "Program cache: off (" << cache.disabled_reason << ")." << std::endl;
+		return;
+	}
+	if (cache.hits == 0 && cache.misses == 0) return;
+	std::cout << "Program cache: " << cache.hits << " hit" << (cache.hits == 1 ? "" : "s")
+	          << " (" << std::fixed << std::setprecision(1) << cache.hit_ms << " ms), "
+	          << cache.misses << " miss" << (cache.misses == 1 ? "" : "es")
+	          << " (" << cache.miss_ms << " ms compiling";
+	if (cache.rejected) std::cout << "; " << cache.rejected << " rejected by the driver";
+	std::cout << "); saved about " << cache.saved_ms << " ms." << std::endl;
+}
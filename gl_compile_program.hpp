@@ -6,6 +6,11 @@
 
 //compiles+links an OpenGL shader program from source.
 // throws on compilation error.
+// linked programs are cached (as program binaries, where the driver supports them) in cache_path(),
+//  so later runs with the same sources and driver skip compiling.
 GLuint gl_compile_program(
 	std::string const &vertex_shader_source,
 	std::string const &fragment_shader_source);
+
+//print program cache hits, misses, and the time saved:
+void report_program_cache();
@@ -0,0 +1,98 @@
+#include "gl_state.hpp"
+
+GLState gl_state;
+
+//record whether a call was issued or skipped:
+static bool count(GLState::Counter *counter, bool issued) {
+	if (issued) counter->issued += 1;
+	else counter->skipped += 1;
+	return issued;
+}
+
+bool GLState::use_program(GLuint program_) {
+	if (program == program_) return count(&frame.programs, false);
+	glUseProgram(program_);
+	program = program_;
+	return count(&frame.programs, true);
+}
+
+bool GLState::bind_vertex_array(GLuint vao) {
+	if (vertex_array == vao) return count(&frame.vertex_arrays, false);
+	glBindVertexArray(vao);
+	vertex_array = vao;
+	return count(&frame.vertex_arrays, true);
+}
+
+bool GLState::bind_buffer(GLenum target, GLuint buffer) {
+	GLuint *cached = nullptr;
+	if (target == GL_ARRAY_BUFFER) cached = &array_buffer;
+	else if (target == GL_UNIFORM_BUFFER) cached = &uniform_buffer;
+
+	if (cached && *cached == buffer) return count(&frame.buffers, false);
+	glBindBuffer(target, buffer);
+	if (cached) *cached = buffer;
+	return count(&frame.buffers, true);
+}
+
+void GLState::bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+	glBindBufferRange(target, index, buffer, offset, size);
+	//binding a range also binds the buffer to the generic binding point:
+	if (target == GL_UNIFORM_BUFFER) uniform_buffer = buffer;
+	count(&frame.buffers, true);
+}
+
+bool GLState::bind_texture(uint32_t unit, GLenum target, GLuint texture) {
+	if (unit >= TrackedUnits) {
+		//untracked unit: pass through (and forget which unit is active):
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		active_unit = unit;
+		return count(&frame.textures, true);
+	}
+
+	Unit &have = units[unit];
+	if (have.texture == texture && (texture == 0 || have.target == target)) return count(&frame.textures, false);
+
+	if (active_unit != unit) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+		active_unit = unit;
+	}
+	//only one target is kept bound per unit, so unbind the old target if it differs:
+	if (have.target != target && have.texture != 0) {
+		glBindTexture(have.target, 0);
+	}
+	glBindTexture(target, texture);
+	have.target = target;
+	have.texture = texture;
+	return count(&frame.textures, true);
+}
+
+bool GLState::set_enabled(GLenum cap, bool enabled) {
+	auto f = capabilities.begin();
+	while (f != capabilities.end() && f->first != cap) ++f;
+	if (f != capabilities.end() && f->second == enabled) return count(&frame.capabilities, false);
+
+	if (enabled) glEnable(cap);
+	else glDisable(cap);
+
+	if (f != capabilities.end()) f->second = enabled;
+	else capabilities.emplace_back(cap, enabled);
+	return count(&frame.capabilities, true);
+}
+
+void GLState::invalidate() {
+	program = Unknown;
+	vertex_array = Unknown;
+	array_buffer = Unknown;
+	uniform_buffer = Unknown;
+	active_unit = Unknown;
+	for (Unit &unit : units) {
+		unit = Unit();
+	}
+	capabilities.clear();
+}
+
+void GLState::end_frame() {
+	last_frame = frame;
+	frame = Counters();
+}
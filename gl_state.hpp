@@ -0,0 +1,74 @@
+#pragma once
+
+/*
+ * gl_state tracks the OpenGL state this codebase changes most often
+ *  (program, vertex array, buffer bindings, texture units, and enable/disable flags)
+ *  and drops calls that would not change anything.
+ *
+ * Use it instead of the raw calls:
+ *   gl_state.use_program(p)                 instead of glUseProgram(p)
+ *   gl_state.bind_vertex_array(vao)         instead of glBindVertexArray(vao)
+ *   gl_state.bind_buffer(target, b)         instead of glBindBuffer(target, b)
+ *   gl_state.bind_texture(unit, target, t)  instead of glActiveTexture(GL_TEXTURE0 + unit) + glBindTexture(target, t)
+ *   gl_state.set_enabled(cap, on)           instead of glEnable(cap) / glDisable(cap)
+ *
+ * NOTE: the cache assumes that it sees every change to the state it tracks;
+ *  if you make a raw call that changes tracked state (or delete a bound object), call gl_state.invalidate() afterward.
+ *
+ * Counts of issued and skipped calls are kept per frame (main.cpp calls end_frame() after each Mode::draw),
+ *  so any Mode can report or check gl_state.last_frame.
+ */
+
+#include "GL.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+struct GLState {
+	//each of these returns 'true' if it actually issued a GL call:
+	bool use_program(GLuint program);
+	bool bind_vertex_array(GLuint vao);
+	bool bind_buffer(GLenum target, GLuint buffer); //(only GL_ARRAY_BUFFER and GL_UNIFORM_BUFFER are cached; other targets pass through)
+	bool bind_texture(uint32_t unit, GLenum target, GLuint texture); //(texture == 0 leaves 'unit' with nothing bound)
+	bool set_enabled(GLenum cap, bool enabled);
+	bool enable(GLenum cap) { return set_enabled(cap, true); }
+	bool disable(GLenum cap) { return set_enabled(cap, false); }
+
+	//always issued (but keeps the generic binding for 'target' up to date):
+	void bind_buffer_range(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+
+	//forget everything cached (the next call of each kind will be issued):
+	void invalidate();
+
+	//call counters:
+	struct Counter {
+		uint32_t issued = 0;
+		uint32_t skipped = 0;
+	};
+	struct Counters {
+		Counter programs, vertex_arrays, buffers, textures, capabilities;
+	};
+	Counters frame; //counts since the last end_frame()
+	Counters last_frame; //counts for the previous frame
+
+	//move 'frame' to 'last_frame' and start counting again:
+	void end_frame();
+
+	//--- internals ---
+	enum : GLuint { Unknown = -1U }; //cached value when state hasn't been set through gl_state
+	enum : uint32_t { TrackedUnits = 16 };
+
+	GLuint program = Unknown;
+	GLuint vertex_array = Unknown;
+	GLuint array_buffer = Unknown;
+	GLuint uniform_buffer = Unknown;
+	uint32_t active_unit = Unknown;
+	struct Unit {
+		GLenum target = GL_TEXTURE_2D;
+		GLuint texture = Unknown;
+	} units[TrackedUnits];
+	std::vector< std::pair< GLenum, bool > > capabilities; //(only caps that have been set through gl_state)
+};
+
+extern GLState gl_state;
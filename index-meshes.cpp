@@ -0,0 +1,425 @@
+//index-meshes converts a triangle-soup .pnct (as written by export-meshes.py) into an indexed one:
+// usage: index-meshes [--quantize] <in.pnct> [out.pnct]
+// (with no output file, the input file is rewritten in place)
+//
+//For each mesh, identical vertices are merged, triangles are reordered for the post-transform vertex cache
+// (Forsyth's "Linear-Speed Vertex Cache Optimisation"), and vertices are reordered by first use.
+//The output has chunks:
+//  "pnct" -- unique vertices, contiguous per mesh
+//  "str0" -- mesh names (copied)
+//  "idx1" -- name range, vertex range, and index range for each mesh
+//  "el16" or "el32" -- mesh-relative triangle indices (16 bits if every mesh has at most 65536 vertices)
+//With --quantize, vertices are packed into 20 bytes (see PackedVertex in Mesh.cpp) and stored as:
+//  "pncq" -- quantized vertices, in place of "pnct"
+//  "bnd0" -- bounds (the range of the quantized positions) for each mesh
+//A per-mesh report of vertex count, size, and average cache miss ratio (ACMR) is printed.
+
+#include "MappedFile.hpp"
+#include "read_write_chunk.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+//vertices are copied as opaque 36-byte records (position, normal, color, texcoord -- see Mesh.cpp):
+struct Vertex {
+	char bytes[36];
+};
+static_assert(sizeof(Vertex) == 36, "Vertex is packed.");
+
+struct IndexEntry0 {
+	uint32_t name_begin, name_end;
+	uint32_t vertex_begin, vertex_end;
+};
+static_assert(sizeof(IndexEntry0) == 16, "Index entry should be packed");
+
+struct IndexEntry1 {
+	uint32_t name_begin, name_end;
+	uint32_t vertex_begin, vertex_end;
+	uint32_t index_begin, index_end;
+};
+static_assert(sizeof(IndexEntry1) == 24, "Index entry should be packed");
+
+//quantized vertex, matching PackedVertex in Mesh.cpp:
+struct PackedVertex {
+	uint16_t Position[4]; //unsigned-normalized over the mesh's bounds (w is padding)
+	uint32_t Normal; //GL_INT_2_10_10_10_REV
+	uint8_t Color[4];
+	uint16_t TexCoord[2]; //half floats
+};
+static_assert(sizeof(PackedVertex) == 20, "PackedVertex is packed.");
+
+struct Bounds {
+	float min[3], max[3];
+};
+static_assert(sizeof(Bounds) == 24, "Bounds are packed.");
+
+//float to half float, rounding to nearest even:
+static uint16_t to_half(float f) {
+	uint32_t bits;
+	std::memcpy(&bits, &f, 4);
+	uint32_t sign = (bits >> 16) & 0x8000;
+	uint32_t mantissa = bits & 0x7fffff;
+	if (((bits >> 23) & 0xff) == 0xff) return uint16_t(sign | 0x7c00 | (mantissa ? 0x200 : 0)); //inf or nan
+	int32_t exponent = int32_t((bits >> 23) & 0xff) - 127 + 15;
+	if (exponent >= 31) return uint16_t(sign | 0x7c00); //too large -> inf
+	if (exponent <= 0) { //subnormal (or zero)
+		if (exponent < -10) return uint16_t(sign);
+		mantissa |= 0x800000;
+		uint32_t shift = uint32_t(14 - exponent);
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1U << shift) - 1);
+		uint32_t mid = 1U << (shift - 1);
+		if (rest > mid || (rest == mid && (half & 1))) half += 1;
+		return uint16_t(sign | half);
+	}
+	uint32_t half = (uint32_t(exponent) << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half += 1; //(a carry into the exponent is correct, even to inf)
+	return uint16_t(sign | half);
+}
+
+//pack 'count' full-precision vertices (in-file layout: float3 position, float3 normal, u8x4 color, float2 texcoord):
+static void quantize(Vertex const *from, uint32_t count, PackedVertex *to, Bounds *bounds) {
+	auto get = [](Vertex const &v, uint32_t offset) {
+		float f;
+		std::memcpy(&f, v.bytes + offset, 4);
+		return f;
+	};
+	for (uint32_t c = 0; c < 3; ++c) {
+		bounds->min[c] = std::numeric_limits< float >::infinity();
+		bounds->max[c] = -std::numeric_limits< float >::infinity();
+	}
+	for (uint32_t v = 0; v < count; ++v) {
+		for (uint32_t c = 0; c < 3; ++c) {
+			bounds->min[c] = std::min(bounds->min[c], get(from[v], 4 * c));
+			bounds->max[c] = std::max(bounds->max[c], get(from[v], 4 * c));
+		}
+	}
+	for (uint32_t v = 0; v < count; ++v) {
+		PackedVertex &out = to[v];
+		for (uint32_t c = 0; c < 3; ++c) {
+			float extent = bounds->max[c] - bounds->min[c];
+			float t = (extent > 0.0f ? (get(from[v], 4 * c) - bounds->min[c]) / extent : 0.0f);
+			out.Position[c] = uint16_t(std::lround(std::clamp(t, 0.0f, 1.0f) * 65535.0f));
+		}
+		out.Position[3] = 0;
+		out.Normal = 0;
+		for (uint32_t c = 0; c < 3; ++c) {
+			int32_t n = int32_t(std::lround(std::clamp(get(from[v], 12 + 4 * c), -1.0f, 1.0f) * 511.0f));
+			out.Normal |= (uint32_t(n) & 0x3ff) << (10 * c);
+		}
+		std::memcpy(out.Color, from[v].bytes + 24, 4);
+		out.TexCoord[0] = to_half(get(from[v], 28));
+		out.TexCoord[1] = to_half(get(from[v], 32));
+	}
+}
+
+//-------------------------
+//vertex cache optimization (after Tom Forsyth, "Linear-Speed Vertex Cache Optimisation", 2006):
+
+static constexpr uint32_t CacheSize = 32;
+
+static float vertex_score(int32_t cache_position, uint32_t remaining_triangles) {
+	if (remaining_triangles == 0) return -1.0f; //no triangles left to emit
+
+	float score = 0.0f;
+	if (cache_position < 0) {
+		//not in cache; no score
+	} else if (cache_position < 3) {
+		//used by the last triangle; fixed score so that strips aren't favored over fans:
+		score = 0.75f;
+	} else {
+		score = std::pow(1.0f - float(cache_position - 3) / float(CacheSize - 3), 1.5f);
+	}
+	//boost vertices with few remaining triangles, so that lone triangles don't get left behind:
+	score += 2.0f * std::pow(float(remaining_triangles), -0.5f);
+	return score;
+}
+
+//reorder the triangles of 'indices' (over 'vertex_count' vertices) in place:
+static void optimize_triangle_order(std::vector< uint32_t > *indices_, uint32_t vertex_count) {
+	std::vector< uint32_t > &indices = *indices_;
+	uint32_t triangle_count = uint32_t(indices.size() / 3);
+	if (triangle_count == 0) return;
+
+	//vertex -> triangles adjacency:
+	std::vector< uint32_t > adjacency_starts(vertex_count + 1, 0);
+	for (uint32_t i : indices) adjacency_starts[i + 1] += 1;
+	for (uint32_t v = 0; v < vertex_count; ++v) adjacency_starts[v + 1] += adjacency_starts[v];
+	std::vector< uint32_t > adjacency(indices.size());
+	{
+		std::vector< uint32_t > fill(adjacency_starts.begin(), adjacency_starts.end() - 1);
+		for (uint32_t t = 0; t < triangle_count; ++t) {
+			for (uint32_t c = 0; c < 3; ++c) {
+				adjacency[fill[indices[3 * t + c]]++] = t;
+			}
+		}
+	}
+
+	std::vector< uint32_t > remaining(vertex_count);
+	std::vector< int32_t > cache_position(vertex_count, -1);
+	std::vector< float > score(vertex_count);
+	for (uint32_t v = 0; v < vertex_count; ++v) {
+		remaining[v] = adjacency_starts[v + 1] - adjacency_starts[v];
+		score[v] = vertex_score(-1, remaining[v]);
+	}
+
+	std::vector< float > triangle_score(triangle_count);
+	std::vector< bool > emitted(triangle_count, false);
+	for (uint32_t t = 0; t < triangle_count; ++t) {
+		triangle_score[t] = score[indices[3 * t + 0]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+	}
+
+	std::vector< uint32_t > result;
+	result.reserve(indices.size());
+	std::vector< uint32_t > cache, next_cache;
+	cache.reserve(CacheSize + 3);
+	next_cache.reserve(CacheSize + 3);
+
+	uint32_t best = -1U;
+	uint32_t scan = 0; //triangles before 'scan' have all been emitted
+	for (uint32_t emit = 0; emit < triangle_count; ++emit) {
+		if (best == -1U) {
+			//nothing in the cache to continue from; take the best remaining triangle:
+			while (emitted[scan]) ++scan;
+			best = scan;
+			for (uint32_t t = scan + 1; t < triangle_count; ++t) {
+				if (!emitted[t] && triangle_score[t] > triangle_score[best]) best = t;
+			}
+		}
+
+		//emit the triangle:
+		emitted[best] = true;
+		uint32_t const *tri = &indices[3 * best];
+		result.insert(result.end(), tri, tri + 3);
+
+		//...remove it from its vertices' remaining triangles:
+		for (uint32_t c = 0; c < 3; ++c) {
+			uint32_t v = tri[c];
+			uint32_t *begin = &adjacency[adjacency_starts[v]];
+			uint32_t *end = begin + remaining[v];
+			*std::find(begin, end, best) = *(end - 1);
+			remaining[v] -= 1;
+		}
+
+		//...and move its vertices to the front of the (LRU) cache:
+		next_cache.assign(tri, tri + 3);
+		for (uint32_t v : cache) {
+			if (v != tri[0] && v != tri[1] && v != tri[2]) next_cache.emplace_back(v);
+		}
+		std::swap(cache, next_cache);
+
+		//rescore vertices that were in (or just fell out of) the cache, then their triangles:
+		for (uint32_t i = 0; i < cache.size(); ++i) {
+			uint32_t v = cache[i];
+			cache_position[v] = (i < CacheSize ? int32_t(i) : -1);
+			score[v] = vertex_score(cache_position[v], remaining[v]);
+		}
+		best = -1U;
+		float best_score = -1.0f;
+		for (uint32_t v : cache) {
+			for (uint32_t a = adjacency_starts[v]; a < adjacency_starts[v] + remaining[v]; ++a) {
+				uint32_t t = adjacency[a];
+				triangle_score[t] = score[indices[3 * t + 0]] + score[indices[3 * t + 1]] + score[indices[3 * t + 2]];
+				if (triangle_score[t] > best_score) {
+					best = t;
+					best_score = triangle_score[t];
+				}
+			}
+		}
+		if (cache.size() > CacheSize) cache.resize(CacheSize);
+	}
+
+	indices = std::move(result);
+}
+
+//average cache misses per triangle for a FIFO post-transform cache of 'CacheSize' entries:
+static float measure_acmr(std::vector< uint32_t > const &indices, uint32_t vertex_count) {
+	if (indices.size() < 3) return 0.0f;
+	std::vector< uint32_t > inserted_at(vertex_count, -1U); //(FIFO write count when the vertex was last inserted)
+	uint32_t writes = 0;
+	uint32_t misses = 0;
+	for (uint32_t i : indices) {
+		if (inserted_at[i] != -1U && writes - inserted_at[i] < CacheSize) continue; //hit
+		misses += 1;
+		inserted_at[i] = writes;
+		writes += 1;
+	}
+	return float(misses) / float(indices.size() / 3);
+}
+
+//-------------------------
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	//when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+	try {
+#endif
+
+	std::vector< std::string > args(argv + 1, argv + argc);
+	bool quantized = false;
+	if (!args.empty() && args[0] == "--quantize") {
+		quantized = true;
+		args.erase(args.begin());
+	}
+	if (args.size() != 1 && args.size() != 2) {
+		std::cerr << "Usage:\n\t" << argv[0] << " [--quantize] <in.pnct> [out.pnct]\n(with no output file, the input file is rewritten)" << std::endl;
+		return 1;
+	}
+	std::string in_file = args[0];
+	std::string out_file = args.back();
+
+	ChunkWriter writer;
+	size_t vertices_before = 0, vertices_after = 0;
+	size_t bytes_before = 0, bytes_after = 0;
+
+	{ //read (and close) the input before writing, since the output may be the same file:
+		MappedFile file(in_file);
+		ChunkReader reader(file.data(), file.data() + file.size());
+		if (reader.lookup("idx1")) {
+			throw std::runtime_error("'" + in_file + "' is already indexed.");
+		}
+		ChunkView< Vertex > soup = reader.find< Vertex >("pnct");
+		ChunkView< char > strings = reader.find< char >("str0");
+		ChunkView< IndexEntry0 > index = reader.find< IndexEntry0 >("idx0");
+		int compression = (reader.lookup("pnct")->encoding == ChunkTocEntry::DeflateBlocks ? 6 : 0); //(keep compressed files compressed)
+
+		vertices_before = soup.size();
+		bytes_before = soup.size() * sizeof(Vertex);
+
+		std::vector< Vertex > vertices;
+		std::vector< IndexEntry1 > entries;
+		std::vector< std::vector< uint32_t > > mesh_indices;
+		entries.reserve(index.size());
+		mesh_indices.reserve(index.size());
+
+		std::cout << std::left << std::setw(24) << "mesh" << std::right
+		          << std::setw(10) << "vertices" << std::setw(10) << "unique"
+		          << std::setw(12) << "ACMR before" << std::setw(12) << "ACMR after" << '\n';
+
+		uint32_t max_mesh_vertices = 0;
+		for (auto const &entry : index) {
+			if (!(entry.name_begin <= entry.name_end && entry.name_end <= strings.size())) {
+				throw std::runtime_error("index entry has out-of-range name begin/end");
+			}
+			if (!(entry.vertex_begin <= entry.vertex_end && entry.vertex_end <= soup.size())) {
+				throw std::runtime_error("index entry has out-of-range vertex start/count");
+			}
+			std::string_view name(strings.data() + entry.name_begin, entry.name_end - entry.name_begin);
+			uint32_t count = entry.vertex_end - entry.vertex_begin;
+			if (count % 3 != 0) {
+				throw std::runtime_error("mesh '" + std::string(name) + "' isn't a list of triangles");
+			}
+
+			//merge identical vertices (byte-for-byte, so nothing that was distinct gets lost):
+			std::unordered_map< std::string_view, uint32_t > unique;
+			unique.reserve(count);
+			std::vector< Vertex > local;
+			std::vector< uint32_t > indices;
+			indices.reserve(count);
+			for (uint32_t v = entry.vertex_begin; v < entry.vertex_end; ++v) {
+				std::string_view key(soup[v].bytes, sizeof(Vertex));
+				auto ret = unique.emplace(key, uint32_t(local.size()));
+				if (ret.second) local.emplace_back(soup[v]);
+				indices.emplace_back(ret.first->second);
+			}
+			float acmr_before = measure_acmr(indices, uint32_t(local.size()));
+
+			optimize_triangle_order(&indices, uint32_t(local.size()));
+
+			//renumber vertices in order of first use (so vertex fetches walk forward through memory):
+			std::vector< uint32_t > remap(local.size(), -1U);
+			uint32_t used = 0;
+			for (uint32_t &i : indices) {
+				if (remap[i] == -1U) remap[i] = used++;
+				i = remap[i];
+			}
+			IndexEntry1 out;
+			out.name_begin = entry.name_begin;
+			out.name_end = entry.name_end;
+			out.vertex_begin = uint32_t(vertices.size());
+			out.vertex_end = out.vertex_begin + used;
+			vertices.resize(out.vertex_end);
+			for (uint32_t v = 0; v < local.size(); ++v) {
+				if (remap[v] != -1U) vertices[out.vertex_begin + remap[v]] = local[v];
+			}
+			float acmr_after = measure_acmr(indices, used);
+
+			std::cout << std::left << std::setw(24) << name << std::right
+			          << std::setw(10) << count << std::setw(10) << used
+			          << std::fixed << std::setprecision(3)
+			          << std::setw(12) << acmr_before << std::setw(12) << acmr_after << '\n';
+
+			max_mesh_vertices = std::max(max_mesh_vertices, used);
+			entries.emplace_back(out);
+			mesh_indices.emplace_back(std::move(indices));
+		}
+
+		//lay out the element array:
+		bool use_16 = (max_mesh_vertices <= 0x10000);
+		std::vector< uint16_t > elements16;
+		std::vector< uint32_t > elements32;
+		for (uint32_t m = 0; m < entries.size(); ++m) {
+			entries[m].index_begin = uint32_t(use_16 ? elements16.size() : elements32.size());
+			for (uint32_t i : mesh_indices[m]) {
+				if (use_16) elements16.emplace_back(uint16_t(i));
+				else elements32.emplace_back(i);
+			}
+			entries[m].index_end = uint32_t(use_16 ? elements16.size() : elements32.size());
+		}
+
+		vertices_after = vertices.size();
+		bytes_after = elements16.size() * sizeof(uint16_t) + elements32.size() * sizeof(uint32_t);
+
+		if (quantized) {
+			std::vector< PackedVertex > packed(vertices.size());
+			std::vector< Bounds > bounds(entries.size());
+			for (uint32_t m = 0; m < entries.size(); ++m) {
+				IndexEntry1 const &entry = entries[m];
+				quantize(&vertices[entry.vertex_begin], entry.vertex_end - entry.vertex_begin, &packed[entry.vertex_begin], &bounds[m]);
+			}
+			bytes_after += packed.size() * sizeof(PackedVertex);
+			writer.add("pncq", packed, 0, compression);
+			writer.add("bnd0", bounds);
+		} else {
+			bytes_after += vertices.size() * sizeof(Vertex);
+			writer.add("pnct", vertices, 0, compression);
+		}
+		writer.add("str0", std::vector< char >(strings.begin(), strings.end()));
+		writer.add("idx1", entries);
+		if (use_16) writer.add("el16", elements16);
+		else writer.add("el32", elements32);
+	}
+
+	std::ofstream out(out_file, std::ios::binary);
+	writer.write(&out);
+	if (!out) {
+		throw std::runtime_error("Failed to write '" + out_file + "'.");
+	}
+
+	std::cout << "total: " << vertices_before << " -> " << vertices_after << " vertices; "
+	          << bytes_before << " -> " << bytes_after << " bytes of vertex + index data ("
+	          << std::fixed << std::setprecision(1) << (bytes_before ? 100.0 * (1.0 - double(bytes_after) / double(bytes_before)) : 0.0) << "% smaller)." << std::endl;
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
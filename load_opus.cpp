@@ -1,24 +1,29 @@
 #include "load_opus.hpp"
+#include "DataFile.hpp"
 
 #include <opusfile.h>
 
+#include <algorithm>
 #include <cassert>
 #include <memory>
 #include <cmath>
 #include <stdexcept>
 #include <iostream>
 
-void load_opus(std::string const &filename, std::vector< float > *data_) {
+void load_opus(std::string const &filename, std::vector< float > *data) {
+	DataFile file(filename);
+	load_opus(file.data(), file.size(), filename, data);
+}
+
+void load_opus(char const *bytes, size_t size, std::string const &filename, std::vector< float > *data_) {
 	assert(data_);
 	auto &data = *data_;
 	data.clear();
 
-	std::cout << "loading '" << filename << "'..."; std::cout.flush();
-
 	//will hold opusfile * int a std::unique_ptr so that it will automatically be deleted:
 	int err = 0;
 	std::unique_ptr< OggOpusFile, decltype(&op_free) > op(
-		op_open_file(filename.c_str(), &err), //pointer to hold
+		op_open_memory(reinterpret_cast< unsigned char const * >(bytes), size, &err), //pointer to hold
 		op_free //deletion function
 	);
 	if (err != 0) {
@@ -49,6 +54,4 @@ void load_opus(std::string const &filename, std::vector< float > *data_) {
 			throw std::runtime_error("opusfile read error " + std::to_string(ret) + " reading \"" + filename + "\".");
 		}
 	}
-
-	std::cout << " done." << std::endl;
 }
@@ -4,4 +4,8 @@
 #include <vector>
 
 //Load an opus file as 48kHz floating-point mono; throws on error:
+// (the file is read through DataFile, so it may be in a mounted pack)
 void load_opus(std::string const &filename, std::vector< float > *data);
+
+//Load an opus file that is already in memory ('name' is used in messages):
+void load_opus(char const *bytes, size_t size, std::string const &name, std::vector< float > *data);
@@ -1,4 +1,5 @@
 #include "load_save_png.hpp"
+#include "DataFile.hpp"
 
 #include <png.h>
 
@@ -17,10 +18,7 @@ void save_png(std::ostream &to, unsigned int width, unsigned int height, glm::u8
 void load_png(std::string filename, glm::uvec2 *size, std::vector< glm::u8vec4 > *data, OriginLocation origin) {
 	assert(size);
 
-	std::ifstream file(filename.c_str(), std::ios::binary);
-	if (!file) {
-		throw std::runtime_error("Failed to open PNG image file '" + filename + "'.");
-	}
+	DataStream file(filename); //(throws if the file can't be opened)
 	if (!load_png(file, &size->x, &size->y, data, origin)) {
 		throw std::runtime_error("Failed to read PNG image from '" + filename + "'.");
 	}
@@ -1,4 +1,5 @@
 #include "load_wav.hpp"
+#include "DataFile.hpp"
 
 #include <SDL.h>
 
@@ -8,7 +9,12 @@
 
 constexpr uint32_t AUDIO_RATE = 48000;
 
-void load_wav(std::string const &filename, std::vector< float > *data_) {
+void load_wav(std::string const &filename, std::vector< float > *data) {
+	DataFile file(filename);
+	load_wav(file.data(), file.size(), filename, data);
+}
+
+void load_wav(char const *bytes, size_t size, std::string const &filename, std::vector< float > *data_) {
 	assert(data_);
 	auto &data = *data_;
 
@@ -16,7 +22,8 @@ void load_wav(std::string const &filename, std::vector< float > *data_) {
 	Uint8 *audio_buf = nullptr;
 	Uint32 audio_len = 0;
 
-	SDL_AudioSpec *have = SDL_LoadWAV(filename.c_str(), &audio_spec, &audio_buf, &audio_len);
+	SDL_RWops *rw = SDL_RWFromConstMem(bytes, int(size));
+	SDL_AudioSpec *have = (rw ? SDL_LoadWAV_RW(rw, 1, &audio_spec, &audio_buf, &audio_len) : nullptr); //(frees 'rw')
 	if (!have) {
 		throw std::runtime_error("Failed to load WAV file '" + filename + "'; SDL says \"" + std::string(SDL_GetError()) + "\"");
 	}
@@ -39,12 +46,4 @@ void load_wav(std::string const &filename, std::vector< float > *data_) {
 		data.assign(reinterpret_cast< float * >(audio_buf), reinterpret_cast< float * >(audio_buf + audio_len));
 	}
 	SDL_FreeWAV(audio_buf);
-
-	float min = 0.0f;
-	float max = 0.0f;
-	for (auto d : data) {
-		min = std::min(min, d);
-		max = std::max(max, d);
-	}
-	std::cout << "Range: " << min << ", " << max << std::endl;
 }
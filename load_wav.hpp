@@ -4,4 +4,8 @@
 #include <vector>
 
 //Load a WAV file as 48kHz floating-point mono; throws on error:
+// (the file is read through DataFile, so it may be in a mounted pack)
 void load_wav(std::string const &filename, std::vector< float > *data);
+
+//Load a WAV file that is already in memory ('name' is used in messages):
+void load_wav(char const *bytes, size_t size, std::string const &name, std::vector< float > *data);
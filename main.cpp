@@ -6,6 +6,8 @@
 
 //For asset loading:
 #include "Load.hpp"
+#include "DataFile.hpp"
+#include "data_path.hpp"
 
 //For sound init:
 #include "Sound.hpp"
@@ -13,6 +15,15 @@
 //GL.hpp will include a non-namespace-polluting set of opengl prototypes:
 #include "GL.hpp"
 
+//For per-frame GL call counters:
+#include "gl_state.hpp"
+
+//For the shader program cache report:
+#include "gl_compile_program.hpp"
+
+//For uploading meshes loaded in the background:
+#include "Mesh.hpp"
+
 //for screenshots:
 #include "load_save_png.hpp"
 
@@ -21,6 +32,7 @@
 
 //...and for c++ standard library functions:
 #include <chrono>
+#include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <memory>
@@ -47,6 +59,17 @@ int main(int argc, char **argv) {
 
 	//------------  initialization ------------
 
+	//Read data from data.pack (built by pack-assets) when there is one, so cold start is one sequential read:
+	// (mounted first so the read can overlap window creation; skipped when hot-reloading, since edits are made to the loose files)
+	// (loose files edited since the pack was built are read instead of their packed copies -- see mount_data_pack)
+	bool hot_reload = false;
+	for (int i = 1; i < argc; ++i) {
+		if (std::string(argv[i]) == "--hot-reload") hot_reload = true;
+	}
+	if (!hot_reload && std::ifstream(data_path("data.pack"))) {
+		mount_data_pack(data_path("data.pack"));
+	}
+
 	//Initialize SDL library:
 	SDL_Init(SDL_INIT_VIDEO);
 
@@ -111,6 +134,14 @@ int main(int argc, char **argv) {
 	//------------ load assets --------------
 	call_load_functions();
 
+	//'--load-trace <file>' saves a trace of startup loading (for tracking cold-start time):
+	for (int i = 1; i + 1 < argc; ++i) {
+		if (std::string(argv[i]) == "--load-trace") write_load_trace(argv[i+1]);
+	}
+
+	//'--hot-reload' reloads assets when their files change:
+	if (hot_reload) start_hot_reload();
+
 	//------------ create game mode + make current --------------
 	Mode::set_current(std::make_shared< PlayMode >());
 
@@ -178,6 +209,12 @@ int main(int argc, char **argv) {
 			//lag to avoid spiral of death:
 			elapsed = std::min(0.1f, elapsed);
 
+			//continue uploading any meshes being loaded in the background:
+			MeshBuffer::upload_pending();
+
+			//swap in any assets that were hot reloaded:
+			update_hot_reload();
+
 			Mode::current->update(elapsed);
 			if (!Mode::current) break;
 		}
@@ -185,6 +222,9 @@ int main(int argc, char **argv) {
 		{ //(3) call the current mode's "draw" function to produce output:
 		
 			Mode::current->draw(drawable_size);
+
+			//finish counting this frame's GL calls (available to modes as gl_state.last_frame):
+			gl_state.end_frame();
 		}
 
 		//Wait until the recently-drawn frame is shown before doing it all again:
@@ -193,6 +233,11 @@ int main(int argc, char **argv) {
 
 
 	//------------  teardown ------------
+	//free the last mode (and the GL buffers its scenes made when drawn) while the GL context still exists:
+	Mode::set_current(nullptr);
+
+	report_unused_loads();
+	report_program_cache();
 	Sound::shutdown();
 
 	SDL_GL_DeleteContext(context);
@@ -206,9 +251,11 @@ int main(int argc, char **argv) {
 #ifdef _WIN32
 	} catch (std::exception const &e) {
 		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		Mode::set_current(nullptr); //(the context is never deleted on this path, so the mode's GL buffers can still be freed)
 		return 1;
 	} catch (...) {
 		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		Mode::set_current(nullptr);
 		throw;
 	}
 #endif
@@ -0,0 +1,107 @@
+//pack-assets bundles data files into one pack, which the game maps and reads through DataFile (see DataFile.hpp):
+// usage: pack-assets <out.pack> <file> [file ...]
+// (files must be in the pack's directory or below it, and are named in the pack relative to it)
+//
+//The pack is one chunk file, with the index first so it is read before any file data:
+//  "str0" -- file names
+//  "pak0" -- name and data range for each file, sorted by name
+//  "dat0" -- file contents, each starting on a ChunkWriter::ChunkAlignment boundary
+//Keeping every file aligned like this means chunk files in the pack can still be viewed in place.
+
+#include "DataFile.hpp"
+#include "MappedFile.hpp"
+#include "read_write_chunk.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+	//when compiled on windows, unhandled exceptions don't have their message printed, which can make debugging simple issues difficult.
+	try {
+#endif
+
+	std::vector< std::string > args(argv + 1, argv + argc);
+	if (args.size() < 2) {
+		std::cerr << "Usage:\n\t" << argv[0] << " <out.pack> <file> [file ...]\n(files are named relative to the pack's directory)" << std::endl;
+		return 1;
+	}
+	std::string out_file = args[0];
+	std::string directory = out_file.substr(0, out_file.find_last_of("/\\") + 1);
+
+	struct Input {
+		std::string name; //in the pack
+		std::string filename; //on disk
+	};
+	std::vector< Input > inputs;
+	for (auto a = args.begin() + 1; a != args.end(); ++a) {
+		std::string const &filename = *a;
+		if (filename.compare(0, directory.size(), directory) != 0 || filename.size() == directory.size()) {
+			throw std::runtime_error("'" + filename + "' isn't in the pack's directory ('" + directory + "').");
+		}
+		std::string name = filename.substr(directory.size());
+		std::replace(name.begin(), name.end(), '\\', '/');
+		inputs.emplace_back(Input{ name, filename });
+	}
+	std::sort(inputs.begin(), inputs.end(), [](Input const &a, Input const &b) { return a.name < b.name; });
+	for (size_t i = 1; i < inputs.size(); ++i) {
+		if (inputs[i-1].name == inputs[i].name) {
+			throw std::runtime_error("'" + inputs[i].name + "' is listed more than once.");
+		}
+	}
+
+	std::vector< char > names;
+	std::vector< DataPackEntry > entries;
+	std::vector< char > data;
+	std::cout << std::left << std::setw(32) << "file" << std::right << std::setw(12) << "bytes" << std::setw(12) << "offset" << '\n';
+	for (auto const &input : inputs) {
+		MappedFile file(input.filename);
+
+		//pad so that the file starts aligned (chunk data is aligned in the file, so this is too):
+		data.resize((data.size() + ChunkWriter::ChunkAlignment - 1) / ChunkWriter::ChunkAlignment * ChunkWriter::ChunkAlignment, '\0');
+		if (data.size() + file.size() > 0xffffffff) {
+			throw std::runtime_error("Packed files are too large to fit in one pack (at '" + input.name + "').");
+		}
+
+		DataPackEntry entry;
+		entry.name_begin = uint32_t(names.size());
+		names.insert(names.end(), input.name.begin(), input.name.end());
+		entry.name_end = uint32_t(names.size());
+		entry.data_begin = uint32_t(data.size());
+		data.insert(data.end(), file.data(), file.data() + file.size());
+		entry.data_end = uint32_t(data.size());
+		entries.emplace_back(entry);
+
+		std::cout << std::left << std::setw(32) << input.name << std::right << std::setw(12) << file.size() << std::setw(12) << entry.data_begin << '\n';
+	}
+
+	ChunkWriter writer;
+	writer.add("str0", names);
+	writer.add("pak0", entries);
+	writer.add("dat0", data);
+
+	std::ofstream out(out_file, std::ios::binary);
+	writer.write(&out);
+	if (!out) {
+		throw std::runtime_error("Failed to write '" + out_file + "'.");
+	}
+
+	std::cout << "packed " << entries.size() << " files (" << data.size() << " bytes) into '" << out_file << "'." << std::endl;
+
+	return 0;
+
+#ifdef _WIN32
+	} catch (std::exception const &e) {
+		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		return 1;
+	} catch (...) {
+		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		throw;
+	}
+#endif
+}
@@ -0,0 +1,106 @@
+#include "read_write_chunk.hpp"
+#include "WorkerPool.hpp"
+
+#include <zlib.h>
+
+#include <atomic>
+
+ChunkBlocks::ChunkBlocks(ChunkTocEntry const &entry, char const *stored) : raw_size(entry.raw_size) {
+	assert(entry.encoding == ChunkTocEntry::DeflateBlocks);
+	if (entry.size < 8) {
+		throw std::runtime_error("Compressed chunk '" + std::string(entry.magic, 4) + "' is missing its block table");
+	}
+	std::memcpy(&block_size, stored, 4);
+	std::memcpy(&block_count, stored + 4, 4);
+	if (block_size == 0 || uint64_t(block_count) != (uint64_t(raw_size) + block_size - 1) / block_size) {
+		throw std::runtime_error("Compressed chunk '" + std::string(entry.magic, 4) + "' has a mismatched block count");
+	}
+	if ((entry.size - 8) / 4 < block_count) {
+		throw std::runtime_error("Compressed chunk '" + std::string(entry.magic, 4) + "' has a truncated block table");
+	}
+	ends = stored + 8;
+	blocks = ends + 4 * size_t(block_count);
+	blocks_size = entry.size - 8 - 4 * size_t(block_count);
+}
+
+size_t ChunkBlocks::decode(uint32_t block, char *to) const {
+	if (block >= block_count) {
+		throw std::runtime_error("Compressed chunk block index out of range");
+	}
+	uint32_t begin = 0;
+	uint32_t end = 0;
+	if (block > 0) std::memcpy(&begin, ends + 4 * size_t(block - 1), 4);
+	std::memcpy(&end, ends + 4 * size_t(block), 4);
+	if (!(begin <= end && end <= blocks_size)) {
+		throw std::runtime_error("Compressed chunk block has out-of-range data");
+	}
+
+	size_t expected = std::min(size_t(block_size), size_t(raw_size) - size_t(block) * block_size);
+	uLongf written = uLongf(expected);
+	int result = uncompress(reinterpret_cast< Bytef * >(to), &written, reinterpret_cast< Bytef const * >(blocks + begin), uLong(end - begin));
+	if (result != Z_OK || written != expected) {
+		throw std::runtime_error("Failed to decompress chunk block (zlib error " + std::to_string(result) + ")");
+	}
+	return expected;
+}
+
+void ChunkBlocks::decode_all(char *to, WorkerPool *workers) const {
+	if (!workers) workers = &WorkerPool::shared();
+
+	//exceptions can't leave a worker thread, so remember the first failure and rethrow it here:
+	std::atomic< bool > failed(false);
+	std::string failure;
+	workers->parallel_for(block_count, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t b = begin; b < end; ++b) {
+			try {
+				decode(b, to + size_t(b) * block_size);
+			} catch (std::exception const &e) {
+				if (!failed.exchange(true)) failure = e.what();
+				return;
+			}
+		}
+	});
+	if (failed) throw std::runtime_error(failure);
+}
+
+std::vector< char > ChunkBlocks::encode(char const *raw, size_t size, uint32_t element_size, int level, uint32_t block_size, WorkerPool *workers) {
+	if (!workers) workers = &WorkerPool::shared();
+	assert(element_size > 0);
+	if (size > 0xffffffff) {
+		throw std::runtime_error("Chunk is too large to compress");
+	}
+
+	//blocks hold whole elements, so streams can hand out decoded blocks as-is:
+	block_size = std::max(block_size / element_size, 1U) * element_size;
+	uint32_t block_count = uint32_t((size + block_size - 1) / block_size);
+
+	std::vector< std::vector< char > > deflated(block_count);
+	std::atomic< bool > failed(false);
+	workers->parallel_for(block_count, 1, [&](uint32_t begin, uint32_t end) {
+		for (uint32_t b = begin; b < end; ++b) {
+			size_t offset = size_t(b) * block_size;
+			uLong length = uLong(std::min(size_t(block_size), size - offset));
+			uLongf deflated_size = compressBound(length);
+			deflated[b].resize(deflated_size);
+			if (compress2(reinterpret_cast< Bytef * >(deflated[b].data()), &deflated_size, reinterpret_cast< Bytef const * >(raw + offset), length, level) != Z_OK) {
+				failed = true;
+				return;
+			}
+			deflated[b].resize(deflated_size);
+		}
+	});
+	if (failed) {
+		throw std::runtime_error("Failed to compress chunk");
+	}
+
+	std::vector< char > stored(8 + 4 * size_t(block_count));
+	std::memcpy(stored.data(), &block_size, 4);
+	std::memcpy(stored.data() + 4, &block_count, 4);
+	uint32_t end = 0;
+	for (uint32_t b = 0; b < block_count; ++b) {
+		end += uint32_t(deflated[b].size());
+		std::memcpy(stored.data() + 8 + 4 * size_t(b), &end, 4);
+		stored.insert(stored.end(), deflated[b].begin(), deflated[b].end());
+	}
+	return stored;
+}
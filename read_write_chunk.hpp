@@ -3,7 +3,12 @@
 #include <iostream>
 #include <vector>
 #include <stdexcept>
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <string>
 
 //helper function that reads an array of structures preceded by a simple header:
 //Expected format:
@@ -41,6 +46,354 @@ void read_chunk(std::istream &from, std::string const &magic, std::vector< T > *
 }
 
 
+//-------------------------
+//zero-copy reading: when the whole file is already in memory (e.g., a MappedFile), chunks can be used in place.
+
+//A ChunkView is a read-only, bounds-checked array view of a chunk's elements:
+// (if the chunk isn't suitably aligned for T in memory, the view holds an aligned copy instead)
+template< typename T >
+struct ChunkView {
+	ChunkView() = default;
+	ChunkView(ChunkView &&) = default;
+	ChunkView &operator=(ChunkView &&) = default;
+	ChunkView(ChunkView const &) = delete; //(would leave 'elements' pointing into the other view's copy)
+	ChunkView &operator=(ChunkView const &) = delete;
+
+	T const *data() const { return elements; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	T const *begin() const { return elements; }
+	T const *end() const { return elements + count; }
+	T const &operator[](size_t i) const { assert(i < count); return elements[i]; }
+	T const &at(size_t i) const {
+		if (i >= count) throw std::out_of_range("Chunk element index out of range");
+		return elements[i];
+	}
+
+	//--- internals ---
+	T const *elements = nullptr;
+	size_t count = 0;
+	std::vector< T > copy; //only used when the chunk was misaligned
+};
+
+//Files may start with a table of contents chunk ("toc1") that lists every other chunk:
+// (written by ChunkWriter; lets readers find or skip chunks without walking the file)
+// ("toc0" tables, with 24-byte entries, came from an earlier writer and are no longer read)
+struct ChunkTocEntry {
+	char magic[4] = {'\0', '\0', '\0', '\0'};
+	uint32_t version = 0; //version of the chunk's contents (0 unless the writer says otherwise)
+	uint32_t element_size = 0; //sizeof(T) for the chunk's elements (0 if unknown, e.g., for legacy files)
+	uint32_t encoding = Raw; //how the chunk's data is stored
+	uint32_t size = 0; //bytes of chunk data as stored (matches the chunk's header)
+	uint32_t raw_size = 0; //bytes of chunk data once decoded (same as size for Raw chunks)
+	uint64_t offset = 0; //offset of the chunk's header from the start of the file
+
+	enum : uint32_t {
+		Raw = 0, //elements, as-is
+		DeflateBlocks = 1, //independently deflated blocks (see ChunkBlocks)
+	};
+};
+static_assert(sizeof(ChunkTocEntry) == 4 + 4 + 4 + 4 + 4 + 4 + 8, "ChunkTocEntry is packed.");
+
+struct WorkerPool; //(see WorkerPool.hpp)
+
+//ChunkBlocks reads and writes the DeflateBlocks encoding, which stores a chunk's data as:
+// |bs|bs|bs|bs| <-- block size (raw bytes per block; a multiple of the element size)
+// |bc|bc|bc|bc| <-- block count
+// |en|en|en|en| * block count <-- end of each block's compressed data (relative to the first block)
+// |zz...zz| <-- each block, deflated (zlib format) on its own
+//so blocks can be decompressed in parallel, or one at a time for streaming.
+// (functions are in read_write_chunk.cpp, so only that file needs zlib)
+struct ChunkBlocks {
+	enum : uint32_t { DefaultBlockSize = 1 << 18 };
+
+	//parse the block table of a DeflateBlocks chunk's stored data; throws if malformed:
+	ChunkBlocks(ChunkTocEntry const &entry, char const *stored);
+
+	//decode block 'block' into 'to' (which needs room for block_size bytes); returns raw bytes written:
+	size_t decode(uint32_t block, char *to) const;
+
+	//decode every block into 'to' (which needs room for raw_size bytes), spread over 'workers' (nullptr: WorkerPool::shared()):
+	void decode_all(char *to, WorkerPool *workers = nullptr) const;
+
+	//deflate 'size' raw bytes in blocks of (about) block_size bytes at zlib 'level', returning the stored data:
+	static std::vector< char > encode(char const *raw, size_t size, uint32_t element_size, int level, uint32_t block_size = DefaultBlockSize, WorkerPool *workers = nullptr);
+
+	uint32_t raw_size = 0;
+	uint32_t block_size = 0;
+	uint32_t block_count = 0;
+	char const *ends = nullptr; //(may be misaligned)
+	char const *blocks = nullptr;
+	size_t blocks_size = 0;
+};
+
+//A ChunkReader indexes the chunks in [begin,end) -- from "toc1" if present, otherwise by scanning headers --
+// and hands out views of them either in file order (read, like read_chunk) or by name (find):
+struct ChunkReader {
+	ChunkReader(char const *begin, char const *end);
+
+	//view of the next chunk's elements; throws (like read_chunk) if the next chunk isn't 'magic' or is malformed:
+	template< typename T >
+	ChunkView< T > read(std::string const &magic);
+
+	//view of the first chunk named 'magic'; throws if there isn't one:
+	template< typename T >
+	ChunkView< T > find(std::string const &magic) const;
+
+	//table of contents entry for the first chunk named 'magic', or nullptr if there isn't one:
+	ChunkTocEntry const *lookup(std::string const &magic) const;
+
+	//view of any chunk in the table of contents:
+	// (encoded chunks are decoded into the view's copy, using 'workers')
+	template< typename T >
+	ChunkView< T > view(ChunkTocEntry const &entry) const;
+
+	bool done() const { return next == toc.size(); } //has read() reached the last chunk?
+	size_t trailing() const { return size_t(end - begin) - indexed_end; } //bytes after the last chunk that aren't chunks
+
+	char const *begin;
+	char const *end;
+	std::vector< ChunkTocEntry > toc; //(does not include "toc1" itself)
+	bool has_toc = false; //was the index read from "toc1"?
+	size_t next = 0; //index of the chunk read() returns next
+	size_t indexed_end = 0; //offset just past the last chunk
+	WorkerPool *workers = nullptr; //decodes compressed chunks (nullptr: WorkerPool::shared())
+};
+
+inline ChunkReader::ChunkReader(char const *begin_, char const *end_) : begin(begin_), end(end_) {
+	struct ChunkHeader {
+		char magic[4] = {'\0', '\0', '\0', '\0'};
+		uint32_t size = 0;
+	};
+	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+
+	size_t length = size_t(end - begin);
+	auto header_at = [&](uint64_t offset, ChunkHeader *header) {
+		if (offset > length || length - offset < sizeof(ChunkHeader)) return false;
+		std::memcpy(header, begin + offset, sizeof(ChunkHeader));
+		return length - offset - sizeof(ChunkHeader) >= header->size;
+	};
+
+	ChunkHeader header;
+	if (header_at(0, &header) && std::string(header.magic, 4) == "toc0") {
+		throw std::runtime_error("Table of contents is from an older format ('toc0'); re-export the file");
+	}
+	if (header_at(0, &header) && std::string(header.magic, 4) == "toc1") {
+		if (header.size % sizeof(ChunkTocEntry) != 0) {
+			throw std::runtime_error("Size of table of contents not divisible by entry size");
+		}
+		toc.resize(header.size / sizeof(ChunkTocEntry));
+		std::memcpy(toc.data(), begin + sizeof(ChunkHeader), header.size);
+		has_toc = true;
+		indexed_end = sizeof(ChunkHeader) + header.size;
+		for (auto const &entry : toc) {
+			ChunkHeader chunk;
+			if (!header_at(entry.offset, &chunk) || std::memcmp(chunk.magic, entry.magic, 4) != 0 || chunk.size != entry.size) {
+				throw std::runtime_error("Table of contents entry for '" + std::string(entry.magic, 4) + "' doesn't match chunk in file");
+			}
+			//views and streams size their reads from raw_size, so it has to agree with what is actually stored:
+			if (entry.encoding == ChunkTocEntry::Raw) {
+				if (entry.raw_size != entry.size) {
+					throw std::runtime_error("Table of contents entry for '" + std::string(entry.magic, 4) + "' has raw size that doesn't match its stored size");
+				}
+			} else if (entry.encoding != ChunkTocEntry::DeflateBlocks) {
+				throw std::runtime_error("Table of contents entry for '" + std::string(entry.magic, 4) + "' has unknown encoding");
+			}
+			indexed_end = std::max(indexed_end, size_t(entry.offset + sizeof(ChunkHeader) + entry.size));
+		}
+	} else {
+		//legacy file: chunks are packed one after another:
+		uint64_t offset = 0;
+		while (header_at(offset, &header)) {
+			ChunkTocEntry entry;
+			std::memcpy(entry.magic, header.magic, 4);
+			entry.size = header.size;
+			entry.raw_size = header.size;
+			entry.offset = offset;
+			toc.emplace_back(entry);
+			offset += sizeof(ChunkHeader) + header.size;
+		}
+		indexed_end = size_t(offset);
+	}
+}
+
+template< typename T >
+ChunkView< T > ChunkReader::read(std::string const &magic) {
+	if (next >= toc.size()) {
+		throw std::runtime_error("Failed to read chunk header");
+	}
+	if (std::string(toc[next].magic, 4) != magic) {
+		throw std::runtime_error("Unexpected magic number in chunk");
+	}
+	next += 1;
+	return view< T >(toc[next-1]);
+}
+
+template< typename T >
+ChunkView< T > ChunkReader::find(std::string const &magic) const {
+	ChunkTocEntry const *entry = lookup(magic);
+	if (!entry) {
+		throw std::runtime_error("Missing '" + magic + "' chunk");
+	}
+	return view< T >(*entry);
+}
+
+inline ChunkTocEntry const *ChunkReader::lookup(std::string const &magic) const {
+	for (auto const &entry : toc) {
+		if (std::string(entry.magic, 4) == magic) return &entry;
+	}
+	return nullptr;
+}
+
+template< typename T >
+ChunkView< T > ChunkReader::view(ChunkTocEntry const &entry) const {
+	if (entry.element_size != 0 && entry.element_size != sizeof(T)) {
+		throw std::runtime_error("Element size of '" + std::string(entry.magic, 4) + "' chunk doesn't match");
+	}
+	if (entry.raw_size % sizeof(T) != 0) {
+		throw std::runtime_error("Size of chunk not divisible by element size");
+	}
+	char const *payload = begin + entry.offset + 8;
+
+	ChunkView< T > view;
+	view.count = entry.raw_size / sizeof(T);
+	if (entry.encoding == ChunkTocEntry::DeflateBlocks) {
+		ChunkBlocks blocks(entry, payload);
+		view.copy.resize(view.count);
+		blocks.decode_all(reinterpret_cast< char * >(view.copy.data()), workers);
+		view.elements = view.copy.data();
+	} else if (entry.encoding != ChunkTocEntry::Raw) {
+		throw std::runtime_error("Unknown encoding for '" + std::string(entry.magic, 4) + "' chunk");
+	} else if (reinterpret_cast< uintptr_t >(payload) % alignof(T) == 0) {
+		view.elements = reinterpret_cast< T const * >(payload);
+	} else {
+		view.copy.resize(view.count);
+		std::memcpy(view.copy.data(), payload, entry.size);
+		view.elements = view.copy.data();
+	}
+	return view;
+}
+
+//A ChunkStream hands out a chunk's elements a block at a time, so huge chunks can be processed in bounded memory:
+//  T const *block; size_t count;
+//  while ((count = stream.next(buffer, capacity, &block))) { ...use block[0 .. count)... }
+// blocks from a stream are read into 'buffer'; blocks from memory (ChunkReader) point into the file when aligned,
+// and compressed chunks are decompressed one ChunkBlocks block at a time (into the stream's own buffer).
+template< typename T >
+struct ChunkStream {
+	ChunkStream(std::istream &from, std::string const &magic); //reads the chunk header; throws like read_chunk
+	ChunkStream(ChunkReader const &from, std::string const &magic); //throws like ChunkReader::find
+
+	//next block of at most 'capacity' elements (0 once the chunk is exhausted):
+	size_t next(T *buffer, size_t capacity, T const **block);
+
+	size_t size() const { return count; } //elements in the chunk
+	size_t remaining() const { return count - position; }
+
+	//throughput so far, timed from the first call to next() to the latest one (so it includes the caller's processing of blocks):
+	double mb_per_s() const { return (seconds > 0.0 ? double(position * sizeof(T)) / (1024.0 * 1024.0) / seconds : 0.0); }
+
+	//--- internals ---
+	std::istream *stream = nullptr; //elements come from here...
+	char const *memory = nullptr; //...or from here
+	ChunkTocEntry entry; //(describes 'memory')
+	std::vector< T > decoded; //current decompressed block, for encoded chunks
+	size_t decoded_at = 0;
+	uint32_t decoded_block = 0; //index of the next block to decompress
+	size_t count = 0;
+	size_t position = 0;
+	std::chrono::steady_clock::time_point started;
+	double seconds = 0.0;
+};
+
+template< typename T >
+ChunkStream< T >::ChunkStream(std::istream &from, std::string const &magic) : stream(&from) {
+	struct ChunkHeader {
+		char magic[4] = {'\0', '\0', '\0', '\0'};
+		uint32_t size = 0;
+	};
+	static_assert(sizeof(ChunkHeader) == 8, "header is packed");
+
+	ChunkHeader header;
+	if (!from.read(reinterpret_cast< char * >(&header), sizeof(header))) {
+		throw std::runtime_error("Failed to read chunk header");
+	}
+	if (std::string(header.magic,4) != magic) {
+		throw std::runtime_error("Unexpected magic number in chunk");
+	}
+	if (header.size % sizeof(T) != 0) {
+		throw std::runtime_error("Size of chunk not divisible by element size");
+	}
+	count = header.size / sizeof(T);
+}
+
+template< typename T >
+ChunkStream< T >::ChunkStream(ChunkReader const &from, std::string const &magic) {
+	ChunkTocEntry const *entry = from.lookup(magic);
+	if (!entry) {
+		throw std::runtime_error("Missing '" + magic + "' chunk");
+	}
+	if (entry->element_size != 0 && entry->element_size != sizeof(T)) {
+		throw std::runtime_error("Element size of '" + magic + "' chunk doesn't match");
+	}
+	if (entry->raw_size % sizeof(T) != 0) {
+		throw std::runtime_error("Size of chunk not divisible by element size");
+	}
+	if (entry->encoding != ChunkTocEntry::Raw && entry->encoding != ChunkTocEntry::DeflateBlocks) {
+		throw std::runtime_error("Unknown encoding for '" + magic + "' chunk");
+	}
+	memory = from.begin + entry->offset + 8;
+	this->entry = *entry;
+	count = entry->raw_size / sizeof(T);
+}
+
+template< typename T >
+size_t ChunkStream< T >::next(T *buffer, size_t capacity, T const **block) {
+	assert(block);
+	auto now = std::chrono::steady_clock::now();
+	if (position == 0) started = now;
+	seconds = std::chrono::duration< double >(now - started).count();
+
+	size_t n = std::min(capacity, count - position);
+	if (n == 0) return 0;
+
+	if (stream) {
+		assert(buffer);
+		if (!stream->read(reinterpret_cast< char * >(buffer), std::streamsize(n * sizeof(T)))) {
+			throw std::runtime_error("Failed to read chunk data.");
+		}
+		*block = buffer;
+	} else if (entry.encoding == ChunkTocEntry::DeflateBlocks) {
+		if (decoded_at == decoded.size()) {
+			ChunkBlocks blocks(entry, memory);
+			if (blocks.block_size % sizeof(T) != 0) {
+				throw std::runtime_error("Block size of chunk not divisible by element size");
+			}
+			decoded.resize(blocks.block_size / sizeof(T));
+			size_t bytes = blocks.decode(decoded_block, reinterpret_cast< char * >(decoded.data()));
+			decoded.resize(bytes / sizeof(T));
+			decoded_block += 1;
+			decoded_at = 0;
+		}
+		n = std::min(n, decoded.size() - decoded_at);
+		*block = decoded.data() + decoded_at;
+		decoded_at += n;
+	} else {
+		char const *at = memory + position * sizeof(T);
+		if (reinterpret_cast< uintptr_t >(at) % alignof(T) == 0) {
+			*block = reinterpret_cast< T const * >(at);
+		} else {
+			assert(buffer);
+			std::memcpy(buffer, at, n * sizeof(T));
+			*block = buffer;
+		}
+	}
+	position += n;
+	return n;
+}
+
+//-------------------------
+
 //helper function to write a chunk of data in the same format as read_chunk:
 template< typename T >
 void write_chunk(std::string const &magic, std::vector< T > const &from, std::ostream *to_) {
@@ -63,3 +416,78 @@ void write_chunk(std::string const &magic, std::vector< T > const &from, std::os
 	to.write(reinterpret_cast< const char * >(&header), sizeof(header));
 	to.write(reinterpret_cast< const char * >(from.data()), from.size() * sizeof(T));
 }
+
+//A ChunkWriter collects chunks and writes them after a table of contents ("toc1"):
+// (each chunk's data is padded to start at a multiple of ChunkAlignment bytes, so ChunkReader can use it in place)
+// chunks added with a compression level from 1 (fastest) to 9 (smallest) are stored as ChunkTocEntry::DeflateBlocks.
+struct ChunkWriter {
+	enum : uint32_t { ChunkAlignment = 16 };
+
+	template< typename T >
+	void add(std::string const &magic, std::vector< T > const &from, uint32_t version = 0, int compression = 0);
+
+	void write(std::ostream *to) const;
+
+	struct Chunk {
+		ChunkTocEntry entry;
+		std::vector< char > data;
+	};
+	std::vector< Chunk > chunks;
+};
+
+template< typename T >
+void ChunkWriter::add(std::string const &magic, std::vector< T > const &from, uint32_t version, int compression) {
+	assert(magic.size() == 4);
+	Chunk chunk;
+	std::memcpy(chunk.entry.magic, magic.data(), 4);
+	chunk.entry.version = version;
+	chunk.entry.element_size = uint32_t(sizeof(T));
+	chunk.entry.raw_size = uint32_t(from.size() * sizeof(T));
+	if (compression > 0) {
+		chunk.entry.encoding = ChunkTocEntry::DeflateBlocks;
+		chunk.data = ChunkBlocks::encode(reinterpret_cast< char const * >(from.data()), chunk.entry.raw_size, uint32_t(sizeof(T)), compression);
+	} else {
+		chunk.data.resize(chunk.entry.raw_size);
+		if (!from.empty()) std::memcpy(chunk.data.data(), from.data(), chunk.entry.raw_size);
+	}
+	if (chunk.data.size() > 0xffffffff) {
+		throw std::runtime_error("Chunk '" + magic + "' is too large to store");
+	}
+	chunk.entry.size = uint32_t(chunk.data.size());
+	chunks.emplace_back(std::move(chunk));
+}
+
+inline void ChunkWriter::write(std::ostream *to_) const {
+	assert(to_);
+	auto &to = *to_;
+
+	//lay out chunks after the table of contents:
+	std::vector< ChunkTocEntry > toc;
+	toc.reserve(chunks.size());
+	uint64_t offset = 8 + chunks.size() * sizeof(ChunkTocEntry);
+	for (auto const &chunk : chunks) {
+		offset += (ChunkAlignment - (offset + 8) % ChunkAlignment) % ChunkAlignment;
+		toc.emplace_back(chunk.entry);
+		toc.back().offset = offset;
+		offset += 8 + chunk.entry.size;
+	}
+
+	write_chunk("toc1", toc, &to);
+	uint64_t at = 8 + toc.size() * sizeof(ChunkTocEntry);
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		static char const zeros[ChunkAlignment] = { };
+		to.write(zeros, std::streamsize(toc[i].offset - at));
+		to.write(chunks[i].entry.magic, 4);
+		to.write(reinterpret_cast< char const * >(&chunks[i].entry.size), 4);
+		to.write(chunks[i].data.data(), std::streamsize(chunks[i].data.size()));
+		at = toc[i].offset + 8 + chunks[i].entry.size;
+	}
+}
+
+//write_chunk into a ChunkWriter (so files with a table of contents are written the same way as plain ones):
+// 'compression' is a zlib level (1-9), or 0 to store the chunk as-is
+template< typename T >
+void write_chunk(std::string const &magic, std::vector< T > const &from, ChunkWriter *to, int compression = 0) {
+	assert(to);
+	to->add(magic, from, 0, compression);
+}
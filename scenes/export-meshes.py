@@ -197,20 +197,31 @@ data = b''.join(data)
 assert(vertex_count * (4*3+4*3+1*4+4*2) == len(data))
 
 #write the data chunk and index chunk to an output blob:
+# (after a table of contents chunk, with each chunk's data aligned to 16 bytes; see ChunkWriter in read_write_chunk.hpp)
+chunks = [
+	(b'pnct', data, 4*3+4*3+1*4+4*2), #first chunk: the data
+	(b'str0', strings, 1), #second chunk: the strings
+	(b'idx0', index, 4*4), #third chunk: the index
+]
 blob = open(outfile, 'wb')
-#first chunk: the data
-blob.write(struct.pack('4s',b'pnct')) #type
-blob.write(struct.pack('I', len(data))) #length
-blob.write(data)
-#second chunk: the strings
-blob.write(struct.pack('4s',b'str0')) #type
-blob.write(struct.pack('I', len(strings))) #length
-blob.write(strings)
-#third chunk: the index
-blob.write(struct.pack('4s',b'idx0')) #type
-blob.write(struct.pack('I', len(index))) #length
-blob.write(index)
+toc = b''
+offset = 8 + len(chunks) * 32
+offsets = []
+for (magic, chunk_data, element_size) in chunks:
+	offset += (16 - (offset + 8) % 16) % 16
+	offsets.append(offset)
+	#magic, version, element size, encoding (raw), stored size, raw size, offset:
+	toc += struct.pack('4sIIIIIQ', magic, 0, element_size, 0, len(chunk_data), len(chunk_data), offset)
+	offset += 8 + len(chunk_data)
+blob.write(struct.pack('4s',b'toc1')) #type
+blob.write(struct.pack('I', len(toc))) #length
+blob.write(toc)
+for ((magic, chunk_data, element_size), offset) in zip(chunks, offsets):
+	blob.write(b'\0' * (offset - blob.tell())) #padding
+	blob.write(struct.pack('4s',magic)) #type
+	blob.write(struct.pack('I', len(chunk_data))) #length
+	blob.write(chunk_data)
 wrote = blob.tell()
 blob.close()
 
-print("Wrote " + str(wrote) + " bytes [== " + str(len(data)+8) + " bytes of data + " + str(len(strings)+8) + " bytes of strings + " + str(len(index)+8) + " bytes of index] to '" + outfile + "'")
+print("Wrote " + str(wrote) + " bytes [== " + str(len(toc)+8) + " bytes of table of contents + " + str(len(data)+8) + " bytes of data + " + str(len(strings)+8) + " bytes of strings + " + str(len(index)+8) + " bytes of index, plus padding] to '" + outfile + "'")
@@ -215,17 +215,35 @@ def write_objects(from_collection):
 write_objects(collection)
 
 #write the strings chunk and scene chunk to an output blob:
+# (after a table of contents chunk, with each chunk's data aligned to 16 bytes; see ChunkWriter in read_write_chunk.hpp)
+chunks = []
+def write_chunk(magic, data, element_size):
+	chunks.append((magic, data, element_size))
+
+write_chunk(b'str0', strings_data, 1)
+write_chunk(b'xfh0', xfh_data, 4+4+4+4*3+4*4+4*3)
+write_chunk(b'msh0', mesh_data, 4+4+4)
+write_chunk(b'cam0', camera_data, 4+4+4+4+4)
+write_chunk(b'lmp0', lamp_data, 4+1+3+4+4+4)
+
 blob = open(outfile, 'wb')
-def write_chunk(magic, data):
+toc = b''
+offset = 8 + len(chunks) * 32
+offsets = []
+for (magic, data, element_size) in chunks:
+	offset += (16 - (offset + 8) % 16) % 16
+	offsets.append(offset)
+	#magic, version, element size, encoding (raw), stored size, raw size, offset:
+	toc += struct.pack('4sIIIIIQ', magic, 0, element_size, 0, len(data), len(data), offset)
+	offset += 8 + len(data)
+blob.write(struct.pack('4s',b'toc1')) #type
+blob.write(struct.pack('I', len(toc))) #length
+blob.write(toc)
+for ((magic, data, element_size), offset) in zip(chunks, offsets):
+	blob.write(b'\0' * (offset - blob.tell())) #padding
 	blob.write(struct.pack('4s',magic)) #type
 	blob.write(struct.pack('I', len(data))) #length
 	blob.write(data)
 
-write_chunk(b'str0', strings_data)
-write_chunk(b'xfh0', xfh_data)
-write_chunk(b'msh0', mesh_data)
-write_chunk(b'cam0', camera_data)
-write_chunk(b'lmp0', lamp_data)
-
 print("Wrote " + str(blob.tell()) + " bytes to '" + outfile + "'")
 blob.close()
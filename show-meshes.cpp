@@ -1,7 +1,10 @@
 #include "Mode.hpp"
 #include "ShowMeshesMode.hpp"
 #include "Load.hpp"
+#include "gl_compile_program.hpp"
 #include "GL.hpp"
+#include "gl_state.hpp"
+#include "Mesh.hpp"
 #include "load_save_png.hpp"
 
 #include <SDL.h>
@@ -83,7 +86,8 @@ int main(int argc, char **argv) {
 	MeshBuffer *buffer = nullptr;
 	if (argc == 2) {
 		try {
-			buffer = new MeshBuffer(argv[1]);
+			//(decoded in the background and uploaded by upload_pending() below, so the window comes up right away)
+			buffer = new MeshBuffer(argv[1], MeshBuffer::Background());
 		} catch (std::exception &e) {
 			std::cerr << "ERROR: " << e.what() << std::endl;
 			usage = true;
@@ -165,6 +169,9 @@ int main(int argc, char **argv) {
 			//lag to avoid spiral of death:
 			elapsed = std::min(0.1f, elapsed);
 
+			//continue uploading any meshes being loaded in the background:
+			MeshBuffer::upload_pending();
+
 			Mode::current->update(elapsed);
 			if (!Mode::current) break;
 		}
@@ -172,6 +179,9 @@ int main(int argc, char **argv) {
 		{ //(3) call the current mode's "draw" function to produce output:
 		
 			Mode::current->draw(drawable_size);
+
+			//finish counting this frame's GL calls (available to modes as gl_state.last_frame):
+			gl_state.end_frame();
 		}
 
 		//Wait until the recently-drawn frame is shown before doing it all again:
@@ -180,6 +190,12 @@ int main(int argc, char **argv) {
 
 
 	//------------  teardown ------------
+	//free the last mode (and the GL buffers its scenes made when drawn) while the GL context still exists:
+	Mode::set_current(nullptr);
+
+	report_unused_loads();
+	report_program_cache();
+
 	SDL_GL_DeleteContext(context);
 	context = 0;
 
@@ -191,9 +207,11 @@ int main(int argc, char **argv) {
 #ifdef _WIN32
 	} catch (std::exception const &e) {
 		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		Mode::set_current(nullptr); //(the context is never deleted on this path, so the mode's GL buffers can still be freed)
 		return 1;
 	} catch (...) {
 		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		Mode::set_current(nullptr);
 		throw;
 	}
 #endif
@@ -1,7 +1,9 @@
 #include "Mode.hpp"
 #include "ShowSceneMode.hpp"
 #include "Load.hpp"
+#include "gl_compile_program.hpp"
 #include "GL.hpp"
+#include "gl_state.hpp"
 #include "load_save_png.hpp"
 #include "ShowSceneProgram.hpp"
 
@@ -107,12 +109,11 @@ int main(int argc, char **argv) {
 	if (scene_file != "") {
 		try {
 			scene = new Scene();
-			scene->load(scene_file, [&buffer,&buffer_vao](Scene &scene, Scene::Transform *transform, std::string const &mesh_name){
+			scene->load(scene_file, [&buffer,&buffer_vao](Scene &scene, Scene::TransformHandle transform, std::string const &mesh_name){
 				if (!buffer_vao) return;
 				Mesh const &mesh = buffer->lookup(mesh_name);
 
-				scene.drawables.emplace_back(transform);
-				Scene::Drawable &drawable = scene.drawables.back();
+				Scene::Drawable &drawable = scene.drawables[scene.drawables.emplace(transform)];
 
 				drawable.pipeline = show_scene_program_pipeline;
 
@@ -120,6 +121,12 @@ int main(int argc, char **argv) {
 				drawable.pipeline.type = mesh.type;
 				drawable.pipeline.start = mesh.start;
 				drawable.pipeline.count = mesh.count;
+				drawable.pipeline.index_type = mesh.index_type;
+				drawable.pipeline.index_start = mesh.index_start;
+				drawable.pipeline.index_count = mesh.index_count;
+				drawable.pipeline.dequantize = mesh.dequantize;
+				drawable.bbox_min = mesh.min;
+				drawable.bbox_max = mesh.max;
 
 			});
 		} catch (std::exception &e) {
@@ -214,6 +221,9 @@ int main(int argc, char **argv) {
 		{ //(3) call the current mode's "draw" function to produce output:
 		
 			Mode::current->draw(drawable_size);
+
+			//finish counting this frame's GL calls (available to modes as gl_state.last_frame):
+			gl_state.end_frame();
 		}
 
 		//Wait until the recently-drawn frame is shown before doing it all again:
@@ -222,6 +232,12 @@ int main(int argc, char **argv) {
 
 
 	//------------  teardown ------------
+	//free the last mode (and the GL buffers its scenes made when drawn) while the GL context still exists:
+	Mode::set_current(nullptr);
+
+	report_unused_loads();
+	report_program_cache();
+
 	SDL_GL_DeleteContext(context);
 	context = 0;
 
@@ -233,9 +249,11 @@ int main(int argc, char **argv) {
 #ifdef _WIN32
 	} catch (std::exception const &e) {
 		std::cerr << "Unhandled exception:\n" << e.what() << std::endl;
+		Mode::set_current(nullptr); //(the context is never deleted on this path, so the mode's GL buffers can still be freed)
 		return 1;
 	} catch (...) {
 		std::cerr << "Unhandled exception (unknown type)." << std::endl;
+		Mode::set_current(nullptr);
 		throw;
 	}
 #endif